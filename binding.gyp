@@ -51,7 +51,21 @@
         # Linux-specific build settings
         ['OS=="linux"', {
           "sources": [ 
-            "native-modules/linux-audio-controller.cpp" 
+            "native-modules/linux-audio-controller.cpp",
+            "native-modules/linux-pulse-engine.cpp",
+            "native-modules/linux-session-history.cpp",
+            "native-modules/linux-stream-diagnostics.cpp",
+            "native-modules/linux-session-notifier.cpp",
+            "native-modules/linux-mute-rules.cpp",
+            "native-modules/linux-session-operations.cpp",
+            "native-modules/linux-stream-loop.cpp",
+            "native-modules/linux-biquad-cascade.cpp",
+            "native-modules/linux-dsp-insert.cpp",
+            "native-modules/linux-fft.cpp",
+            "native-modules/linux-spectrum-analyzer.cpp",
+            "native-modules/linux-event-trace.cpp",
+            "native-modules/linux-session-actions.cpp",
+            "native-modules/linux-session-scenes.cpp"
           ],
           "include_dirs": [
             "<!@(node -p \"require('node-addon-api').include\")",
@@ -62,7 +76,9 @@
               '<!@(pkg-config --libs pulse)' # Link against PulseAudio
             ]
           },
-          'defines': [ 'NAPI_DISABLE_CPP_EXCEPTIONS' ]
+          'defines': [ 'NAPI_DISABLE_CPP_EXCEPTIONS' ],
+          'cflags_cc': [ '-std=c++17', '-pthread' ],
+          'ldflags': [ '-pthread' ]
         }]
       ]
     }
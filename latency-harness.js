@@ -0,0 +1,370 @@
+const { spawn, execFile, execFileSync } = require('child_process');
+const fs = require('fs');
+const readline = require('readline');
+const { performance } = require('perf_hooks');
+const { Worker, isMainThread, parentPort, workerData } = require('worker_threads');
+
+const NULL_SINK_NAME = 'ampcore_latency';
+const PROBE_CLIENT_NAME = 'AmpCore Latency Probe';
+const STAGES = ['ipc', 'queue', 'native', 'server', 'total'];
+
+/**
+ * High-resolution wall-clock timestamp in milliseconds. The renderer and the
+ * server event worker use the same expression, so their stamps share one time
+ * base.
+ */
+function now() {
+  return performance.timeOrigin + performance.now();
+}
+
+/**
+ * Parses harness options from the command line, e.g.
+ * `--latency-rates=30,60,120 --latency-samples=200 --latency-report=out.json`.
+ */
+function parseOptions(argv) {
+  const options = { rates: [30, 60, 120], samples: 200, report: null };
+
+  argv.forEach(arg => {
+    const [key, value] = arg.split('=');
+    if (key === '--latency-rates' && value) {
+      options.rates = value.split(',').map(Number).filter(rate => rate > 0);
+    } else if (key === '--latency-samples' && value) {
+      options.samples = Math.max(1, parseInt(value, 10) || options.samples);
+    } else if (key === '--latency-report' && value) {
+      options.report = value;
+    }
+  });
+
+  return options;
+}
+
+/**
+ * Collects per-sample stage timestamps from the main process and matches them
+ * with the change notifications PulseAudio emits for the probe stream.
+ */
+class LatencyProbe {
+  constructor() {
+    this.targetIndex = null;
+    this.readVolume = null;
+    this.pending = [];
+    this.samples = [];
+    this.events = [];
+    this.reading = false;
+  }
+
+  // Called by the set-volume handler in main.js once the native call returns
+  record(sample) {
+    if (this.targetIndex === null || sample.inputAt === undefined) return;
+    this.pending.push(sample);
+  }
+
+  // Called for every `change` event on the probe sink input. The event itself
+  // does not say what changed, so the stream's volume is read back before any
+  // sample is counted as acknowledged
+  serverChanged(at) {
+    this.events.push(at);
+    if (!this.reading) this.drainEvents();
+  }
+
+  async drainEvents() {
+    this.reading = true;
+    try {
+      while (this.events.length > 0) {
+        const events = this.events.splice(0);
+        let volume = null;
+        try {
+          volume = this.readVolume ? await this.readVolume(this.targetIndex) : null;
+        } catch (error) {
+          console.error('Error reading probe volume:', error.message);
+        }
+        if (volume !== null) this.acknowledge(events, volume);
+      }
+    } finally {
+      this.reading = false;
+    }
+  }
+
+  // `volume` is what the server reported after `events`; the samples it
+  // reflects are the ones up to the last pending sample with that volume
+  acknowledge(events, volume) {
+    let matched = -1;
+    for (let i = this.pending.length - 1; i >= 0; i--) {
+      if (Math.abs(this.pending[i].volume - volume) < 0.5) {
+        matched = i;
+        break;
+      }
+    }
+    // No pending sample has this volume: a cork, attribute update or other
+    // unrelated change, which acknowledges nothing
+    if (matched < 0) return;
+
+    // Samples that returned after the last event are reported by a later one
+    const lastEvent = events[events.length - 1];
+    let count = 0;
+    while (count <= matched && this.pending[count].returnAt <= lastEvent) count++;
+
+    this.pending.splice(0, count).forEach(sample => {
+      sample.serverAt = events.find(at => at >= sample.returnAt);
+      this.samples.push(sample);
+    });
+  }
+
+  takeSamples() {
+    const samples = this.samples;
+    this.samples = [];
+    this.pending = [];
+    this.events = [];
+    return samples;
+  }
+}
+
+function percentile(sorted, p) {
+  if (sorted.length === 0) return NaN;
+  const index = Math.min(sorted.length - 1, Math.ceil((p / 100) * sorted.length) - 1);
+  return sorted[Math.max(0, index)];
+}
+
+/**
+ * Reduces raw samples to per-stage latency distributions (milliseconds).
+ */
+function summarize(samples) {
+  const stageValues = {
+    ipc: samples.map(s => s.receivedAt - s.inputAt),
+    queue: samples.map(s => s.callAt - s.receivedAt),
+    native: samples.map(s => s.returnAt - s.callAt),
+    server: samples.map(s => s.serverAt - s.returnAt),
+    total: samples.map(s => s.serverAt - s.inputAt),
+  };
+
+  const summary = {};
+  STAGES.forEach(stage => {
+    const sorted = stageValues[stage].slice().sort((a, b) => a - b);
+    const sum = sorted.reduce((acc, value) => acc + value, 0);
+    summary[stage] = {
+      count: sorted.length,
+      mean: sorted.length ? sum / sorted.length : NaN,
+      p50: percentile(sorted, 50),
+      p90: percentile(sorted, 90),
+      p99: percentile(sorted, 99),
+      max: sorted.length ? sorted[sorted.length - 1] : NaN,
+    };
+  });
+
+  return summary;
+}
+
+function printSummary(rate, sent, summary) {
+  const fmt = value => (Number.isFinite(value) ? value.toFixed(2).padStart(8) : '       -');
+  console.log(`\nRate ${rate} Hz: ${summary.total.count}/${sent} samples reached the server`);
+  console.log('stage       mean      p50      p90      p99      max   (ms)');
+  STAGES.forEach(stage => {
+    const s = summary[stage];
+    console.log(`${stage.padEnd(8)}${fmt(s.mean)} ${fmt(s.p50)} ${fmt(s.p90)} ${fmt(s.p99)} ${fmt(s.max)}`);
+  });
+}
+
+/**
+ * Loads a null sink and plays silence into it so there is a real sink input
+ * for the mixer to control without touching the user's audible devices.
+ */
+function startProbeStream() {
+  const moduleIndex = execFileSync('pactl', [
+    'load-module', 'module-null-sink', `sink_name=${NULL_SINK_NAME}`,
+  ]).toString().trim();
+
+  const silence = fs.openSync('/dev/zero', 'r');
+  const player = spawn('pacat', [
+    '--playback', `--device=${NULL_SINK_NAME}`, `--client-name=${PROBE_CLIENT_NAME}`,
+    '--raw', '--format=s16le', '--rate=48000', '--channels=2',
+  ], { stdio: [silence, 'ignore', 'inherit'] });
+  fs.closeSync(silence);
+
+  return {
+    player,
+    stop() {
+      player.kill();
+      try {
+        execFileSync('pactl', ['unload-module', moduleIndex]);
+      } catch (error) {
+        console.error('Error unloading null sink:', error.message);
+      }
+    },
+  };
+}
+
+// pactl output is localized; the parsers below expect the C locale
+const PACTL_ENV = { ...process.env, LC_ALL: 'C' };
+
+/**
+ * Worker side of watchServerEvents: follows `pactl subscribe` and posts
+ * `{ index, at }` for every change event on a sink input. Stamping here keeps
+ * the server stage independent of how long the main thread is blocked.
+ */
+function runEventWorker() {
+  const subscriber = spawn('pactl', ['subscribe'], { stdio: ['ignore', 'pipe', 'inherit'], env: PACTL_ENV });
+  const lines = readline.createInterface({ input: subscriber.stdout });
+
+  lines.on('line', line => {
+    const at = now();
+    const match = /^Event 'change' on sink-input #(\d+)/.exec(line);
+    if (match) parentPort.postMessage({ index: Number(match[1]), at });
+  });
+  lines.on('close', () => parentPort.close());
+  parentPort.on('message', () => {
+    subscriber.kill();
+    // In a worker this ends only the worker thread
+    process.exit(0);
+  });
+}
+
+/**
+ * Follows server change events on sink inputs from a worker thread.
+ * `waitForChange(index)` resolves on the next change event for that sink input.
+ */
+function watchServerEvents(onSinkInputChange) {
+  const worker = new Worker(__filename, { workerData: { role: 'server-events' } });
+  const waiters = [];
+
+  worker.on('message', ({ index, at }) => {
+    for (let i = waiters.length - 1; i >= 0; i--) {
+      if (waiters[i].index === index) waiters.splice(i, 1)[0].resolve(at);
+    }
+    onSinkInputChange(index, at);
+  });
+  worker.on('error', error => console.error('Server event watcher failed:', error.message));
+
+  return {
+    waitForChange(index) {
+      return new Promise(resolve => waiters.push({ index, resolve }));
+    },
+    stop() {
+      worker.postMessage('stop');
+    },
+  };
+}
+
+/**
+ * Toggles the probe's mute until `pactl subscribe` reports it, so the slider is
+ * not driven before the subscription is live, then restores it.
+ */
+async function waitForSubscriber(events, index) {
+  for (let attempt = 0; attempt < 50; attempt++) {
+    const seen = events.waitForChange(index);
+    execFileSync('pactl', ['set-sink-input-mute', String(index), 'toggle']);
+    const acked = await Promise.race([seen.then(() => true), delay(100).then(() => false)]);
+    // Undo the toggle; the restore's own event is awaited so it cannot be
+    // mistaken for the first sample's acknowledgement
+    const restored = events.waitForChange(index);
+    execFileSync('pactl', ['set-sink-input-mute', String(index), 'toggle']);
+    if (acked) {
+      await restored;
+      return;
+    }
+  }
+  throw new Error('pactl subscribe did not report events for the probe stream');
+}
+
+/**
+ * Reads the probe sink input's volume as a 0-100 percentage of its loudest
+ * channel, or null when the stream is gone.
+ */
+function readSinkInputVolume(index) {
+  return new Promise((resolve, reject) => {
+    execFile('pactl', ['list', 'sink-inputs'], { env: PACTL_ENV }, (error, stdout) => {
+      if (error) {
+        reject(error);
+        return;
+      }
+      const block = stdout.split(/^Sink Input #/m).find(part => part.startsWith(`${index}\n`));
+      const line = block && /^\s*Volume:(.*)$/m.exec(block);
+      if (!line) {
+        resolve(null);
+        return;
+      }
+      const raw = [...line[1].matchAll(/(\d+) \/\s*\d+%/g)].map(m => Number(m[1]));
+      resolve(raw.length ? (Math.max(...raw) * 100) / 65536 : null);
+    });
+  });
+}
+
+function delay(ms) {
+  return new Promise(resolve => setTimeout(resolve, ms));
+}
+
+async function waitForProbeSession(audioController) {
+  for (let attempt = 0; attempt < 50; attempt++) {
+    const session = audioController.getAudioSessions().find(s => s.name === PROBE_CLIENT_NAME);
+    if (session) return session;
+    await delay(100);
+  }
+  throw new Error('Probe stream did not appear on the audio server');
+}
+
+/**
+ * Asks the renderer to drag the probe slider and resolves once it is done.
+ */
+function driveSlider(window, ipcMain, request) {
+  return new Promise((resolve, reject) => {
+    ipcMain.once('latency-harness-drive-done', (event, result) => {
+      if (result.error) {
+        reject(new Error(result.error));
+      } else {
+        resolve(result);
+      }
+    });
+    window.webContents.send('latency-harness-drive', request);
+  });
+}
+
+/**
+ * Runs the end-to-end latency measurement against a hidden window and
+ * resolves with the per-rate summaries.
+ */
+async function runLatencyHarness({ window, ipcMain, audioController, probe, argv }) {
+  const options = parseOptions(argv);
+  const probeStream = startProbeStream();
+  let events = null;
+
+  try {
+    const session = await waitForProbeSession(audioController);
+    events = watchServerEvents((index, at) => {
+      if (index === probe.targetIndex) probe.serverChanged(at);
+    });
+    await waitForSubscriber(events, Number(session.id));
+
+    probe.readVolume = readSinkInputVolume;
+    probe.targetIndex = Number(session.id);
+
+    const results = [];
+    for (const rate of options.rates) {
+      const { sent } = await driveSlider(window, ipcMain, {
+        sessionId: session.id,
+        rateHz: rate,
+        samples: options.samples,
+      });
+
+      // Give the last operations time to be acknowledged and reported
+      await delay(500);
+
+      const summary = summarize(probe.takeSamples());
+      printSummary(rate, sent, summary);
+      results.push({ rate, sent, summary });
+    }
+
+    if (options.report) {
+      fs.writeFileSync(options.report, JSON.stringify(results, null, 2));
+      console.log(`\nLatency report written to ${options.report}`);
+    }
+
+    return results;
+  } finally {
+    if (events) events.stop();
+    probeStream.stop();
+  }
+}
+
+if (!isMainThread && workerData && workerData.role === 'server-events') {
+  runEventWorker();
+}
+
+module.exports = { LatencyProbe, runLatencyHarness, now };
@@ -1,12 +1,40 @@
-const { app, BrowserWindow, ipcMain } = require('electron');
+const { app, BrowserWindow, ipcMain, powerMonitor, Tray, Menu, screen } = require('electron');
 const path = require('path');
 const fs = require('fs');
+const { performance } = require('perf_hooks');
 const audioController = require('bindings')('windows_audio_controller');
 
 let mainWindow;
 let lastAudioSessions = {};
+
+// Tray mini-mixer: a popup view next to the main window
+let tray = null;
+let trayWindow = null;
+const TRAY_UPDATE_INTERVAL_MS = 100;
+
+// Mixer views fed by their own native subscription, by webContents id
+const mixerViews = new Map();
+// Mixer views fed by polling, on platforms without pushed changes
+const polledViews = new Set();
+
+// Headless end-to-end latency measurement (see latency-harness.js)
+const LATENCY_HARNESS = process.argv.includes('--latency-harness');
+let latencyProbe = null;
+
+// Event traces: `--record-trace=<file>` logs what the audio server sends;
+// `--replay-trace=<file> [--replay-speed=N]` drives the UI from such a log
+// instead of the server (speed 0 replays as fast as possible)
+function getArgValue(name) {
+  const prefix = `--${name}=`;
+  const arg = process.argv.find(entry => entry.startsWith(prefix));
+  return arg ? arg.slice(prefix.length) : null;
+}
+const RECORD_TRACE = getArgValue('record-trace');
+const REPLAY_TRACE = getArgValue('replay-trace');
 const EXCLUSIONS_FILE = path.join(app.getPath('userData'), 'exclusions.json');
 const MUTE_STATES_FILE = path.join(app.getPath('userData'), 'muteStates.json');
+const HOTKEYS_FILE = path.join(app.getPath('userData'), 'hotkeys.json');
+const SCENES_FILE = path.join(app.getPath('userData'), 'scenes.json');
 
 // Load exclusions from file
 function loadExclusions() {
@@ -55,6 +83,102 @@ function saveMuteStates(muteStates) {
 // Initialize mute states on app startup
 let savedMuteStates = loadMuteStates();
 
+// Load saved scenes: name -> { data (base64), savedAt, lastApplyMs }
+function loadScenes() {
+  try {
+    if (fs.existsSync(SCENES_FILE)) {
+      const data = fs.readFileSync(SCENES_FILE, 'utf8');
+      return JSON.parse(data);
+    }
+  } catch (error) {
+    console.error('Error loading scenes:', error);
+  }
+  return {};
+}
+
+// Save scenes to file
+function saveScenes(scenes) {
+  try {
+    fs.writeFileSync(SCENES_FILE, JSON.stringify(scenes));
+  } catch (error) {
+    console.error('Error saving scenes:', error);
+  }
+}
+
+let savedScenes = loadScenes();
+
+// Load hotkey bindings: [{ accelerator, app, volume | mute, capture }]
+function loadHotkeys() {
+  try {
+    if (fs.existsSync(HOTKEYS_FILE)) {
+      const data = fs.readFileSync(HOTKEYS_FILE, 'utf8');
+      return JSON.parse(data);
+    }
+  } catch (error) {
+    console.error('Error loading hotkeys:', error);
+  }
+  return [];
+}
+
+/**
+ * Registers the hotkeys from hotkeys.json as native actions (Linux), e.g.
+ * `{ "accelerator": "Alt+F9", "app": "spotify", "volume": -5 }` or
+ * `{ "accelerator": "Alt+F12", "app": "discord", "mute": "toggle" }`.
+ * The native module resolves the app against its own session table and
+ * applies the step to every matching stream in one round trip.
+ */
+function registerHotkeys() {
+  if (!audioController.defineAction) return;
+
+  loadHotkeys().forEach((binding, index) => {
+    const name = `hotkey-${index}`;
+    const { accelerator, ...action } = binding;
+    try {
+      if (!accelerator || !audioController.defineAction(name, action)) {
+        console.error('Invalid hotkey binding:', binding);
+        return;
+      }
+    } catch (error) {
+      console.error('Invalid hotkey binding:', binding, error.message);
+      return;
+    }
+
+    const registered = globalShortcut.register(accelerator, () => {
+      // Fire and forget: the result arrives once the server has replied, so
+      // a slow server never stalls the main thread
+      audioController.runAction(name, result => {
+        // Keep the saved mute states in step with what the hotkey applied
+        if (result.muted !== undefined && !action.capture) {
+          result.names.forEach(appName => {
+            savedMuteStates[appName] = result.muted;
+          });
+          saveMuteStates(savedMuteStates);
+        }
+      });
+    });
+    if (!registered) {
+      console.error('Could not register hotkey:', accelerator);
+    }
+  });
+}
+
+/**
+ * Returns the value native calls should target for a session: the numeric
+ * handle when the platform module provides one, otherwise the string id.
+ */
+function sessionTarget(session) {
+  return session.handle !== undefined ? session.handle : session.id;
+}
+
+/**
+ * Whether a session is a capture device or capture stream (Linux). Saved
+ * mute states are keyed by application name and belong to playback, so
+ * capture sessions are left out of them.
+ */
+function isCaptureSession(session) {
+  return session.kind === 'source' || session.kind === 'source-output';
+}
+
 /**
  * Creates the main application window.
  */
@@ -63,15 +187,22 @@ function createWindow() {
     width: 1000,
     height: 750,
     title: "AmpCore",
+    show: !LATENCY_HARNESS,
     webPreferences: {
       nodeIntegration: true,
       contextIsolation: false,
+      // Hidden harness windows must not have their timers throttled
+      backgroundThrottling: !LATENCY_HARNESS,
     },
     autoHideMenuBar: false,
   });
 
   mainWindow.loadFile('index.html');
-  mainWindow.on('closed', () => { mainWindow = null; });
+  attachMixerView(mainWindow, 0);
+  mainWindow.on('closed', () => {
+    mainWindow = null;
+    destroyTray();
+  });
 
   // Notify the renderer process that it can start requesting data
   mainWindow.webContents.on('did-finish-load', () => {
@@ -87,13 +218,187 @@ function createWindow() {
   mainWindow.on('leave-full-screen', () => {
     mainWindow.setMenuBarVisibility(true);
   });
+
+  // Let the native module idle while nobody can see the mixer
+  mainWindow.on('minimize', updateActivityMode);
+  mainWindow.on('hide', updateActivityMode);
+  mainWindow.on('restore', updateActivityMode);
+  mainWindow.on('show', updateActivityMode);
+}
+
+let screenLocked = false;
+
+/**
+ * Whether a window is on screen.
+ */
+function isWindowShown(window) {
+  return !!window && !window.isDestroyed() && window.isVisible() && !window.isMinimized();
+}
+
+/**
+ * Tells the native module how much work the UI currently needs: foreground
+ * while the main window or the tray mixer is visible, background while both
+ * are minimized or hidden, suspended while the screen is locked.
+ */
+function updateActivityMode() {
+  if (!audioController.setActivityMode) return;
+
+  let mode = 'foreground';
+  if (screenLocked) {
+    mode = 'suspended';
+  } else if (!isWindowShown(mainWindow) && !isWindowShown(trayWindow)) {
+    mode = 'background';
+  }
+  audioController.setActivityMode(mode);
+}
+
+/**
+ * Streams session deltas to a mixer view over a native subscription of its
+ * own, with its own rate limit. Every view reads the one native session
+ * table, so extra views add no audio-server traffic. A view resubscribes
+ * when it (re)loads, and its first batch holds the whole table. Platforms
+ * without pushed changes get the last polled table, then the polled deltas.
+ */
+function attachMixerView(window, intervalMs) {
+  const contents = window.webContents;
+  const contentsId = contents.id;
+
+  const detach = () => {
+    polledViews.delete(contents);
+    const subscription = mixerViews.get(contentsId);
+    if (subscription !== undefined) {
+      audioController.offSessionsChanged(subscription);
+      mixerViews.delete(contentsId);
+    }
+  };
+
+  contents.on('did-finish-load', () => {
+    detach();
+    if (!audioController.onSessionsChanged) {
+      contents.send('audio-sessions-delta', { changed: Object.values(lastAudioSessions), removed: [] });
+      polledViews.add(contents);
+      return;
+    }
+
+    const subscription = audioController.onSessionsChanged((changed, removed) => {
+      if (!contents.isDestroyed()) {
+        contents.send('audio-sessions-delta', { changed, removed });
+      }
+    }, { intervalMs });
+    mixerViews.set(contentsId, subscription);
+  });
+  window.on('closed', detach);
+}
+
+/**
+ * Path of a bundled resource in development and packaged builds.
+ */
+function resourcePath(name) {
+  return app.isPackaged
+    ? path.join(process.resourcesPath, 'resources', name)
+    : path.join(__dirname, 'resources', name);
+}
+
+/**
+ * Creates the tray icon and its (hidden) mini-mixer popup.
+ */
+function createTray() {
+  trayWindow = new BrowserWindow({
+    width: 340,
+    height: 420,
+    show: false,
+    frame: false,
+    resizable: false,
+    skipTaskbar: true,
+    alwaysOnTop: true,
+    webPreferences: {
+      nodeIntegration: true,
+      contextIsolation: false,
+    },
+  });
+
+  trayWindow.loadFile('tray.html');
+  attachMixerView(trayWindow, TRAY_UPDATE_INTERVAL_MS);
+  trayWindow.on('blur', () => trayWindow.hide());
+  trayWindow.on('show', updateActivityMode);
+  trayWindow.on('hide', updateActivityMode);
+  trayWindow.on('closed', () => { trayWindow = null; });
+
+  tray = new Tray(resourcePath('icon.png'));
+  tray.setToolTip('AmpCore');
+  tray.on('click', toggleTrayMixer);
+  // Some Linux desktops only deliver tray clicks through a menu
+  tray.setContextMenu(Menu.buildFromTemplate([
+    { label: 'Mixer', click: toggleTrayMixer },
+    { label: 'Open AmpCore', click: () => { if (mainWindow) mainWindow.show(); } },
+    { type: 'separator' },
+    { label: 'Quit', click: () => app.quit() },
+  ]));
+}
+
+/**
+ * Shows the mini-mixer next to the tray icon, or hides it.
+ */
+function toggleTrayMixer() {
+  if (!trayWindow) return;
+  if (trayWindow.isVisible()) {
+    trayWindow.hide();
+    return;
+  }
+
+  // Tray bounds are empty on some Linux desktops; fall back to the pointer
+  const trayBounds = tray.getBounds();
+  const anchor = trayBounds.width > 0
+    ? { x: trayBounds.x + Math.round(trayBounds.width / 2), y: trayBounds.y }
+    : screen.getCursorScreenPoint();
+  const workArea = screen.getDisplayNearestPoint(anchor).workArea;
+  const [width, height] = trayWindow.getSize();
+
+  const x = Math.min(Math.max(anchor.x - Math.round(width / 2), workArea.x), workArea.x + workArea.width - width);
+  const y = anchor.y < workArea.y + workArea.height / 2
+    ? workArea.y
+    : workArea.y + workArea.height - height;
+  trayWindow.setPosition(x, y);
+  trayWindow.show();
+  trayWindow.focus();
+}
+
+/**
+ * Removes the tray icon and its popup.
+ */
+function destroyTray() {
+  if (trayWindow) {
+    trayWindow.destroy();
+    trayWindow = null;
+  }
+  if (tray) {
+    tray.destroy();
+    tray = null;
+  }
 }
 
 const { globalShortcut } = require('electron');
 
 app.on('ready', () => {
+  startEventTrace();
   createWindow();
+
+  if (LATENCY_HARNESS) {
+    startLatencyHarness();
+    return;
+  }
+
+  createTray();
   
+  powerMonitor.on('lock-screen', () => {
+    screenLocked = true;
+    updateActivityMode();
+  });
+  powerMonitor.on('unlock-screen', () => {
+    screenLocked = false;
+    updateActivityMode();
+  });
+
   // Register F11 shortcut for fullscreen toggle
   globalShortcut.register('F11', () => {
     if (mainWindow) {
@@ -101,11 +406,67 @@ app.on('ready', () => {
       mainWindow.setFullScreen(!isFullScreen);
     }
   });
+
+  registerHotkeys();
 });
 
+/**
+ * Runs the latency harness once the renderer is up, then quits.
+ */
+function startLatencyHarness() {
+  const { LatencyProbe, runLatencyHarness } = require('./latency-harness');
+  latencyProbe = new LatencyProbe();
+
+  mainWindow.webContents.once('did-finish-load', () => {
+    runLatencyHarness({
+      window: mainWindow,
+      ipcMain,
+      audioController,
+      probe: latencyProbe,
+      argv: process.argv,
+    }).then(() => {
+      app.exit(0);
+    }).catch(error => {
+      console.error('Latency harness failed:', error);
+      app.exit(1);
+    });
+  });
+}
+
+/**
+ * Starts trace recording or replay when asked for on the command line.
+ */
+function startEventTrace() {
+  if (REPLAY_TRACE) {
+    if (!audioController.startReplay) {
+      console.error('Event trace replay is not supported on this platform');
+      return;
+    }
+    const speed = Number(getArgValue('replay-speed') || 1);
+    if (!audioController.startReplay(REPLAY_TRACE, { speed })) {
+      console.error('Could not replay event trace:', REPLAY_TRACE);
+    }
+  } else if (RECORD_TRACE) {
+    if (!audioController.startTraceRecording) {
+      console.error('Event trace recording is not supported on this platform');
+      return;
+    }
+    if (!audioController.startTraceRecording(RECORD_TRACE)) {
+      console.error('Could not record event trace:', RECORD_TRACE);
+    }
+  }
+}
+
 // Make sure to unregister shortcuts when app is about to quit
 app.on('will-quit', () => {
   globalShortcut.unregisterAll();
+
+  if (RECORD_TRACE && audioController.stopTraceRecording) {
+    const summary = audioController.stopTraceRecording();
+    if (summary) {
+      console.log(`Recorded ${summary.events} events (${summary.bytes} bytes) over ${Math.round(summary.durationMs)} ms`);
+    }
+  }
 });
 
 
@@ -116,7 +477,10 @@ app.on('window-all-closed', () => {
 
 // Re-create the window when clicking the dock icon (macOS behavior)
 app.on('activate', () => {
-  if (mainWindow === null) createWindow();
+  if (mainWindow === null) {
+    createWindow();
+    if (!LATENCY_HARNESS) createTray();
+  }
 });
 
 /**
@@ -126,80 +490,225 @@ function sendAudioSessions() {
   try {
     const audioSessions = audioController.getAudioSessions();
     let updatedSessions = {};
-    let hasChanges = false;
+    const changed = [];
 
     // Track new and existing sessions
     audioSessions.forEach(session => {
       updatedSessions[session.id] = session;
       
       // Apply saved mute state if available
-      if (savedMuteStates[session.name] !== undefined) {
+      if (!isCaptureSession(session) && savedMuteStates[session.name] !== undefined) {
         // Only update if the current mute state differs from saved state
         if (session.muted !== savedMuteStates[session.name]) {
-          audioController.setMute(session.id, savedMuteStates[session.name]);
+          audioController.setMute(sessionTarget(session), savedMuteStates[session.name]);
           session.muted = savedMuteStates[session.name];
         }
       }
       
-      if (!lastAudioSessions[session.id]) {
-        hasChanges = true; // New session detected
+      // New sessions and sessions whose state changed since the last poll
+      const previous = lastAudioSessions[session.id];
+      if (!previous || previous.name !== session.name || previous.volume !== session.volume ||
+          previous.muted !== session.muted) {
+        changed.push(session);
       }
     });
 
-    // Detect removed sessions
-    Object.keys(lastAudioSessions).forEach(sessionId => {
-      if (!updatedSessions[sessionId]) {
-        hasChanges = true;
-      }
-    });
+    const removed = Object.keys(lastAudioSessions).filter(sessionId => !updatedSessions[sessionId]);
+    lastAudioSessions = updatedSessions;
 
-    // Update renderer only if changes are detected
-    if (hasChanges) {
-      lastAudioSessions = updatedSessions;
-      console.log("Audio session changes detected. Updating renderer.");
-      if (mainWindow) {
-        mainWindow.webContents.send('audio-sessions-update', Object.values(updatedSessions));
-      }
+    // Views only hear about what changed
+    if (changed.length > 0 || removed.length > 0) {
+      polledViews.forEach(contents => {
+        if (!contents.isDestroyed()) {
+          contents.send('audio-sessions-delta', { changed, removed });
+        }
+      });
     }
   } catch (error) {
     console.error('Error retrieving audio sessions:', error);
   }
 }
 
+/**
+ * Applies a batch of session changes pushed by the native module to the main
+ * process's copy of the table. The windows get their own deltas.
+ */
+function applySessionChanges(changedSessions, removedIds) {
+  removedIds.forEach(sessionId => {
+    delete lastAudioSessions[sessionId];
+  });
+  changedSessions.forEach(session => {
+    lastAudioSessions[session.id] = session;
+  });
+}
+
 /**
  * Handles volume adjustment requests from the renderer.
  */
-ipcMain.on('set-volume', (event, { sessionId, volume }) => {
-  console.log(`Setting volume: SessionID=${sessionId}, Volume=${volume}`);
+ipcMain.on('set-volume', (event, { sessionId, handle, volume, inputAt }) => {
+  const receivedAt = latencyProbe ? performance.timeOrigin + performance.now() : 0;
+  if (!latencyProbe) console.log(`Setting volume: SessionID=${sessionId}, Volume=${volume}`);
   setImmediate(() => {
-    audioController.setVolume(sessionId, volume);
+    const callAt = latencyProbe ? performance.timeOrigin + performance.now() : 0;
+    audioController.setVolume(handle !== undefined ? handle : sessionId, volume);
+    if (latencyProbe) {
+      latencyProbe.record({ volume, inputAt, receivedAt, callAt, returnAt: performance.timeOrigin + performance.now() });
+    }
   });
 });
 
+/**
+ * Sets a session's balance and/or fade (Linux), each from -1 to 1.
+ */
+ipcMain.handle('set-balance', (event, { handle, balance, fade }) => {
+  if (!audioController.setBalance) return false;
+  return audioController.setBalance(handle, { balance, fade });
+});
+
 /**
  * Handles mute toggle requests from the renderer.
  */
 ipcMain.on('toggle-mute', (event, { sessionId, newMuteState }) => {
   console.log(`Toggling mute: SessionID=${sessionId}`);
   setImmediate(() => {
-    audioController.setMute(sessionId, newMuteState);
+    // Save the mute state by application name before applying it, so the
+    // native rule enforcement does not revert the change
+    const session = lastAudioSessions[sessionId];
+    if (!isCaptureSession(session)) {
+      savedMuteStates[session.name] = newMuteState;
+      saveMuteStates(savedMuteStates);
+      if (audioController.setMuteRules) audioController.setMuteRules(savedMuteStates);
+    }
+
+    audioController.setMute(sessionTarget(lastAudioSessions[sessionId]), newMuteState);
     lastAudioSessions[sessionId].muted = newMuteState;
-    
-    // Save the mute state by application name
-    const sessionName = lastAudioSessions[sessionId].name;
-    savedMuteStates[sessionName] = newMuteState;
-    saveMuteStates(savedMuteStates);
 
     event.sender.send('mute-updated', { sessionId, muted: newMuteState });
   });
 });
 
 /**
- * Sends the last known audio session data to the renderer upon request.
+ * Returns a session's recent activity history (Linux) as a packed
+ * Float64Array of rows laid out as audioController.historyColumns.
+ */
+ipcMain.handle('get-session-history', (event, { handle, fromMs, toMs, resolutionMs }) => {
+  if (!audioController.getSessionHistory) return null;
+  return audioController.getSessionHistory(handle, fromMs, toMs, resolutionMs || 0);
+});
+
+/**
+ * Returns per-stream latency and resampler diagnostics (Linux).
+ */
+ipcMain.handle('get-stream-diagnostics', (event, options) => {
+  if (!audioController.getStreamDiagnostics) return [];
+  return audioController.getStreamDiagnostics(options || {});
+});
+
+/**
+ * Moves streams to another device (Linux): sink inputs to a sink, source
+ * outputs to a source. All moves go out in one batch.
+ */
+ipcMain.handle('move-sessions', (event, { handles, deviceHandle }) => {
+  if (!audioController.moveSessions) return [];
+  return audioController.moveSessions(handles, deviceHandle);
+});
+
+/**
+ * Moves every stream of an application that matches the device's direction
+ * (playback for a sink, capture for a source) to that device (Linux).
+ */
+ipcMain.handle('route-application', (event, { name, deviceHandle }) => {
+  if (!audioController.moveSessions) return [];
+  const device = Object.values(lastAudioSessions).find(session => session.handle === deviceHandle);
+  if (!device) return [];
+
+  const streamKind = device.kind === 'sink' ? 'sink-input' : 'source-output';
+  const handles = Object.values(lastAudioSessions)
+    .filter(session => session.name === name && session.kind === streamKind)
+    .map(session => session.handle);
+  return handles.length ? audioController.moveSessions(handles, deviceHandle) : [];
+});
+
+/**
+ * Per-application equalizer (Linux). Bands are
+ * [{ type: 'lowshelf' | 'peaking' | 'highshelf', frequency, gain, q }].
+ */
+ipcMain.handle('enable-dsp', (event, { handle, bands }) => {
+  if (!audioController.enableDsp) return false;
+  return audioController.enableDsp(handle, bands);
+});
+
+ipcMain.handle('set-dsp-bands', (event, { handle, bands }) => {
+  if (!audioController.setDspBands) return false;
+  return audioController.setDspBands(handle, bands);
+});
+
+ipcMain.handle('disable-dsp', (event, { handle }) => {
+  if (!audioController.disableDsp) return false;
+  return audioController.disableDsp(handle);
+});
+
+ipcMain.handle('get-dsp-stats', () => {
+  if (!audioController.getDspStats) return [];
+  return audioController.getDspStats();
+});
+
+/**
+ * Captures the current mixer state as a named scene (Linux).
+ */
+ipcMain.handle('save-scene', (event, { name }) => {
+  if (!audioController.captureScene || !name) return false;
+  const data = audioController.captureScene();
+  savedScenes[name] = { data: data.toString('base64'), savedAt: Date.now(), lastApplyMs: null };
+  saveScenes(savedScenes);
+  return true;
+});
+
+/**
+ * Restores a named scene and records how long it took to apply.
+ */
+ipcMain.handle('restore-scene', (event, { name }) => {
+  const scene = savedScenes[name];
+  if (!audioController.restoreScene || !scene) return null;
+
+  const result = audioController.restoreScene(Buffer.from(scene.data, 'base64'));
+  if (!result) return null;
+
+  // The scene's mute states become the saved ones, as a click would make them
+  Object.assign(savedMuteStates, result.muteRules);
+  saveMuteStates(savedMuteStates);
+
+  scene.lastApplyMs = result.elapsedMs;
+  saveScenes(savedScenes);
+  return result;
+});
+
+/**
+ * Lists saved scenes with their entries and last apply time.
+ */
+ipcMain.handle('list-scenes', () => {
+  if (!audioController.describeScene) return [];
+  return Object.entries(savedScenes).map(([name, scene]) => ({
+    name,
+    savedAt: scene.savedAt,
+    lastApplyMs: scene.lastApplyMs,
+    entries: audioController.describeScene(Buffer.from(scene.data, 'base64')),
+  }));
+});
+
+ipcMain.handle('delete-scene', (event, { name }) => {
+  if (!savedScenes[name]) return false;
+  delete savedScenes[name];
+  saveScenes(savedScenes);
+  return true;
+});
+
+/**
+ * Returns runs and press-to-applied latency for each hotkey action (Linux).
  */
-ipcMain.on('request-audio-sessions', (event) => {
-  console.log("Renderer requested audio sessions. Sending...");
-  event.sender.send('audio-sessions-update', Object.values(lastAudioSessions));
+ipcMain.handle('get-action-stats', () => {
+  if (!audioController.getActionStats) return [];
+  return audioController.getActionStats();
 });
 
 // Handle exclusion updates
@@ -229,8 +738,15 @@ ipcMain.on('save-mute-state', (event, { appName, muted }) => {
   
   // Save to disk
   saveMuteStates(savedMuteStates);
+  if (audioController.setMuteRules) audioController.setMuteRules(savedMuteStates);
 });
 
-// Set up periodic updates for audio sessions
+// Set up audio session updates. Native modules that push changes also enforce
+// saved mute states themselves; the others are polled.
 const UPDATE_INTERVAL = 1000; // Update every second
-setInterval(sendAudioSessions, UPDATE_INTERVAL);
\ No newline at end of file
+if (audioController.onSessionsChanged) {
+  audioController.setMuteRules(savedMuteStates);
+  audioController.onSessionsChanged(applySessionChanges);
+} else {
+  setInterval(sendAudioSessions, UPDATE_INTERVAL);
+}
\ No newline at end of file
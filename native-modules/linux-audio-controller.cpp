@@ -7,439 +7,1302 @@
 #include <string>
 #include <map>
 #include <memory>
-#include <thread>
-#include <mutex>
-#include <condition_variable>
+#include <algorithm>
+#include <cmath>
+#include "linux-audio-session.h"
+#include "linux-pulse-engine.h"
+#include "linux-session-history.h"
+#include "linux-stream-diagnostics.h"
+#include "linux-session-notifier.h"
+#include "linux-mute-rules.h"
+#include "linux-session-operations.h"
+#include "linux-dsp-insert.h"
+#include "linux-stream-loop.h"
+#include "linux-spectrum-analyzer.h"
+#include "linux-event-trace.h"
+#include "linux-session-actions.h"
+#include "linux-session-scenes.h"
 
-// Structure to hold audio session information
-struct AudioSession {
-    std::string id;
-    std::string name;
-    float volume;
-    bool muted;
+// Get all audio sessions (system and applications) from the live session table
+std::vector<AudioSession> GetAudioSessions() {
+    PulseEngine& engine = PulseEngine::Instance();
+    if (!engine.Start()) {
+        return {};
+    }
+
+    return engine.GetSessions();
+}
+
+// Run one request on the engine's operation path
+static bool RunSessionOperation(SessionHandle handle, PulseEngine::Request request) {
+    if (!IsValidSessionHandle(handle)) {
+        return false;
+    }
+
+    PulseEngine& engine = PulseEngine::Instance();
+    return engine.Start() && engine.RunAndWait(std::move(request));
+}
+
+// Look up a session in the live table, starting the engine if needed
+static bool GetLiveSession(SessionHandle handle, AudioSession* session) {
+    PulseEngine& engine = PulseEngine::Instance();
+    return IsValidSessionHandle(handle) && engine.Start() && engine.GetSession(handle, session);
+}
+
+// Set volume for a specific audio session. The per-channel volume comes from
+// the table, so the stream's own channel layout and balance are kept.
+bool SetVolume(SessionHandle handle, float volume) {
+    if (volume < 0.0f || volume > 100.0f) {
+        return false;
+    }
+
+    AudioSession session;
+    if (!GetLiveSession(handle, &session)) {
+        return false;
+    }
+
+    return RunSessionOperation(handle, VolumeRequest(handle, ScaledVolume(session, volume)));
+}
+
+// Shift a session's volume between channels without changing its loudest one
+bool SetBalance(SessionHandle handle, const float* balance, const float* fade) {
+    AudioSession session;
+    pa_cvolume cvolume;
+    if (!GetLiveSession(handle, &session) || !BalancedVolume(session, balance, fade, &cvolume)) {
+        return false;
+    }
+
+    return RunSessionOperation(handle, VolumeRequest(handle, cvolume));
+}
+
+// Set mute state for a specific audio session
+bool SetMute(SessionHandle handle, bool mute) {
+    return RunSessionOperation(handle, MuteRequest(handle, mute));
+}
+
+// Move streams to a device in one pipelined batch; results follow the input order
+std::vector<bool> MoveSessions(const std::vector<SessionHandle>& streams, SessionHandle device) {
+    std::vector<bool> moved(streams.size(), false);
+
+    PulseEngine& engine = PulseEngine::Instance();
+    if (streams.empty() || !IsValidSessionHandle(device) || !engine.Start()) {
+        return moved;
+    }
+
+    std::vector<PulseEngine::Request> requests;
+    for (SessionHandle stream : streams) {
+        requests.push_back(MoveRequest(stream, device));
+    }
+
+    std::vector<OperationResult> results;
+    engine.RunBatch(std::move(requests), &results);
+    for (size_t i = 0; i < results.size(); i++) {
+        moved[i] = results[i].success;
+    }
+    return moved;
+}
+
+// Compatibility shims for callers that still pass string ids
+bool SetVolume(const std::string& sessionId, float volume) {
+    SessionHandle handle;
+    return ParseSessionId(sessionId, &handle) && SetVolume(handle, volume);
+}
+
+bool SetMute(const std::string& sessionId, bool mute) {
+    SessionHandle handle;
+    return ParseSessionId(sessionId, &handle) && SetMute(handle, mute);
+}
+
+// Read a session handle (number) or legacy session id (string) from a JS value
+static bool ReadSessionHandle(const Napi::Value& value, SessionHandle* handle) {
+    if (value.IsNumber()) {
+        double raw = value.As<Napi::Number>().DoubleValue();
+        if (!(raw >= 0.0 && raw <= 9007199254740991.0) || raw != static_cast<double>(static_cast<uint64_t>(raw))) {
+            return false;
+        }
+        *handle = static_cast<SessionHandle>(raw);
+        return IsValidSessionHandle(*handle);
+    }
+
+    if (value.IsString()) {
+        return ParseSessionId(value.As<Napi::String>().Utf8Value(), handle);
+    }
+
+    return false;
+}
+
+// Name of a session kind as reported to JS
+static const char* SessionKindName(SessionKind kind) {
+    static const char* const kindNames[] = { "invalid", "sink", "sink-input", "source", "source-output" };
+    return kindNames[static_cast<uint32_t>(kind)];
+}
+
+// Convert a session record to the object shape the renderer expects
+static Napi::Object SessionToObject(Napi::Env env, const AudioSession& session) {
+    SessionKind kind = GetHandleKind(session.handle);
+
+    Napi::Object sessionObj = Napi::Object::New(env);
+    sessionObj.Set("id", session.id);
+    sessionObj.Set("handle", static_cast<double>(session.handle));
+    sessionObj.Set("kind", SessionKindName(kind));
+    sessionObj.Set("name", session.name);
+    sessionObj.Set("volume", session.volume);
+    sessionObj.Set("muted", session.muted);
+
+    // Per-channel state, for sessions that have a volume of their own
+    const pa_cvolume& cvolume = session.cvolume;
+    if (cvolume.channels > 0) {
+        Napi::Array channelMap = Napi::Array::New(env, cvolume.channels);
+        Napi::Array channelVolumes = Napi::Array::New(env, cvolume.channels);
+        for (uint8_t i = 0; i < cvolume.channels; i++) {
+            channelMap[i] = Napi::String::New(env, pa_channel_position_to_string(session.channel_map.map[i]));
+            channelVolumes[i] = Napi::Number::New(env, (static_cast<float>(cvolume.values[i]) * 100.0f) / PA_VOLUME_NORM);
+        }
+        sessionObj.Set("channels", cvolume.channels);
+        sessionObj.Set("channelMap", channelMap);
+        sessionObj.Set("channelVolumes", channelVolumes);
+        if (pa_channel_map_can_balance(&session.channel_map)) {
+            sessionObj.Set("balance", pa_cvolume_get_balance(&cvolume, &session.channel_map));
+        }
+        if (pa_channel_map_can_fade(&session.channel_map)) {
+            sessionObj.Set("fade", pa_cvolume_get_fade(&cvolume, &session.channel_map));
+        }
+    }
+
+    // Streams also name the device they are attached to
+    if (IsStreamKind(kind)) {
+        sessionObj.Set("deviceHandle", static_cast<double>(MakeSessionHandle(DeviceKindFor(kind), session.device_index)));
+    }
+    return sessionObj;
 }
 
 // Node.js Native API bindings
 Napi::Array GetAudioSessionsWrapper(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
-    
+
     std::vector<AudioSession> sessions = GetAudioSessions();
     Napi::Array result = Napi::Array::New(env, sessions.size());
-    
+
     for (size_t i = 0; i < sessions.size(); i++) {
-        Napi::Object sessionObj = Napi::Object::New(env);
-        sessionObj.Set("id", sessions[i].id);
-        sessionObj.Set("name", sessions[i].name);
-        sessionObj.Set("volume", sessions[i].volume);
-        sessionObj.Set("muted", sessions[i].muted);
-        
-        result[i] = sessionObj;
+        result[i] = SessionToObject(env, sessions[i]);
     }
-    
+
     return result;
 }
 
 Napi::Boolean SetVolumeWrapper(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
-    
-    if (info.Length() < 2 || !info[0].IsString() || !info[1].IsNumber()) {
-        Napi::TypeError::New(env, "Expected sessionId (string) and volume (number)").ThrowAsJavaScriptException();
+
+    if (info.Length() < 2 || !(info[0].IsNumber() || info[0].IsString()) || !info[1].IsNumber()) {
+        Napi::TypeError::New(env, "Expected session handle (number) or sessionId (string) and volume (number)").ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
+    }
+
+    SessionHandle handle;
+    if (!ReadSessionHandle(info[0], &handle)) {
         return Napi::Boolean::New(env, false);
     }
-    
-    std::string sessionId = info[0].As<Napi::String>();
     float volume = info[1].As<Napi::Number>().FloatValue();
-    
-    bool success = SetVolume(sessionId, volume);
+
+    bool success = SetVolume(handle, volume);
     return Napi::Boolean::New(env, success);
 }
 
+// Set balance and/or fade from the cached channel map in one request:
+// (handle, { balance, fade }) -> bool. Both range from -1 to 1 (left to right,
+// rear to front); false when the session's channels cannot express them.
+Napi::Boolean SetBalanceWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    SessionHandle handle;
+    if (info.Length() < 2 || !(info[0].IsNumber() || info[0].IsString()) || !info[1].IsObject()) {
+        Napi::TypeError::New(env, "Expected session handle and options (object)").ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
+    }
+    if (!ReadSessionHandle(info[0], &handle)) {
+        return Napi::Boolean::New(env, false);
+    }
+
+    Napi::Object options = info[1].As<Napi::Object>();
+    float values[2];
+    const float* axes[2] = { nullptr, nullptr };
+    const char* const names[2] = { "balance", "fade" };
+    for (int i = 0; i < 2; i++) {
+        Napi::Value value = options.Get(names[i]);
+        if (value.IsUndefined()) {
+            continue;
+        }
+        double number = value.IsNumber() ? value.As<Napi::Number>().DoubleValue() : NAN;
+        if (!(number >= -1.0 && number <= 1.0)) {
+            Napi::TypeError::New(env, "Expected balance and fade between -1 and 1").ThrowAsJavaScriptException();
+            return Napi::Boolean::New(env, false);
+        }
+        values[i] = static_cast<float>(number);
+        axes[i] = &values[i];
+    }
+    if (!axes[0] && !axes[1]) {
+        Napi::TypeError::New(env, "Expected balance or fade").ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
+    }
+
+    return Napi::Boolean::New(env, SetBalance(handle, axes[0], axes[1]));
+}
+
 Napi::Boolean SetMuteWrapper(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
-    
-    if (info.Length() < 2 || !info[0].IsString() || !info[1].IsBoolean()) {
-        Napi::TypeError::New(env, "Expected sessionId (string) and mute (boolean)").ThrowAsJavaScriptException();
+
+    if (info.Length() < 2 || !(info[0].IsNumber() || info[0].IsString()) || !info[1].IsBoolean()) {
+        Napi::TypeError::New(env, "Expected session handle (number) or sessionId (string) and mute (boolean)").ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
+    }
+
+    SessionHandle handle;
+    if (!ReadSessionHandle(info[0], &handle)) {
         return Napi::Boolean::New(env, false);
     }
-    
-    std::string sessionId = info[0].As<Napi::String>();
     bool mute = info[1].As<Napi::Boolean>().Value();
-    
-    bool success = SetMute(sessionId, mute);
+
+    bool success = SetMute(handle, mute);
     return Napi::Boolean::New(env, success);
 }
 
-// Initialize Node.js module
-Napi::Object Init(Napi::Env env, Napi::Object exports) {
-    exports.Set("getAudioSessions", Napi::Function::New(env, GetAudioSessionsWrapper));
-    exports.Set("setVolume", Napi::Function::New(env, SetVolumeWrapper));
-    exports.Set("setMute", Napi::Function::New(env, SetMuteWrapper));
-    
-    return exports;
+// Move streams to a device: (handle | handle[], deviceHandle) -> boolean | boolean[].
+// Sink inputs go to sinks and source outputs to sources; an array is sent as
+// one pipelined batch.
+Napi::Value MoveSessionsWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    SessionHandle device;
+    if (info.Length() < 2 || !ReadSessionHandle(info[1], &device)) {
+        Napi::TypeError::New(env, "Expected session handle(s) and device handle").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    std::vector<SessionHandle> streams;
+    bool single = !info[0].IsArray();
+    if (single) {
+        SessionHandle stream;
+        if (!ReadSessionHandle(info[0], &stream)) {
+            Napi::TypeError::New(env, "Expected session handle").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        streams.push_back(stream);
+    } else {
+        Napi::Array handles = info[0].As<Napi::Array>();
+        for (uint32_t i = 0; i < handles.Length(); i++) {
+            SessionHandle stream;
+            if (!ReadSessionHandle(handles.Get(i), &stream)) {
+                Napi::TypeError::New(env, "Expected session handles").ThrowAsJavaScriptException();
+                return env.Null();
+            }
+            streams.push_back(stream);
+        }
+    }
+
+    std::vector<bool> moved = MoveSessions(streams, device);
+    if (single) {
+        return Napi::Boolean::New(env, moved[0]);
+    }
+
+    Napi::Array result = Napi::Array::New(env, moved.size());
+    for (size_t i = 0; i < moved.size(); i++) {
+        result[i] = Napi::Boolean::New(env, moved[i]);
+    }
+    return result;
 }
 
-NODE_API_MODULE(linux_audio_controller, Init);
+// Resolve a legacy session id to its handle, or null if it is malformed
+Napi::Value ParseSessionIdWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
 
-// Global state for PulseAudio
-struct PulseState {
-    pa_mainloop* mainloop;
-    pa_mainloop_api* mainloop_api;
-    pa_context* context;
-    bool ready;
-    std::vector<AudioSession> sessions;
-    std::mutex mutex;
-    std::condition_variable cv;
-    bool operation_done;
-    bool success;
-};
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Expected sessionId (string)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
 
-// Create and initialize the PulseAudio state
-std::unique_ptr<PulseState> CreatePulseState() {
-    auto state = std::make_unique<PulseState>();
-    
-    state->mainloop = pa_mainloop_new();
-    if (!state->mainloop) {
-        return nullptr;
-    }
-    
-    state->mainloop_api = pa_mainloop_get_api(state->mainloop);
-    state->context = pa_context_new(state->mainloop_api, "Audio Mixer");
-    state->ready = false;
-    state->operation_done = false;
-    state->success = false;
-    
-    return state;
-}
-
-// Cleanup PulseAudio state
-void CleanupPulseState(PulseState* state) {
-    if (state->context) {
-        pa_context_disconnect(state->context);
-        pa_context_unref(state->context);
-    }
-    
-    if (state->mainloop) {
-        pa_mainloop_free(state->mainloop);
-    }
-}
-
-// Context state callback
-void ContextStateCallback(pa_context* context, void* userdata) {
-    PulseState* state = static_cast<PulseState*>(userdata);
-    
-    switch (pa_context_get_state(context)) {
-        case PA_CONTEXT_READY:
-            state->ready = true;
-            state->cv.notify_all();
-            break;
-        case PA_CONTEXT_FAILED:
-        case PA_CONTEXT_TERMINATED:
-            state->ready = false;
-            state->cv.notify_all();
-            break;
-        default:
-            break;
-    }
-}
-
-// Connect to PulseAudio server
-bool ConnectToPulseAudio(PulseState* state) {
-    pa_context_set_state_callback(state->context, ContextStateCallback, state);
-    
-    if (pa_context_connect(state->context, NULL, PA_CONTEXT_NOFLAGS, NULL) < 0) {
-        return false;
+    SessionHandle handle;
+    if (!ParseSessionId(info[0].As<Napi::String>().Utf8Value(), &handle)) {
+        return env.Null();
     }
-    
-    // Wait for the context to be ready
-    std::unique_lock<std::mutex> lock(state->mutex);
-    if (!state->cv.wait_for(lock, std::chrono::seconds(5), [state]() { return state->ready; })) {
-        return false;
+
+    return Napi::Number::New(env, static_cast<double>(handle));
+}
+
+// Return a session's activity history as a packed Float64Array of
+// historyColumns-sized rows: (handle, fromMs, toMs[, resolutionMs])
+Napi::Value GetSessionHistoryWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 3 || !(info[0].IsNumber() || info[0].IsString()) || !info[1].IsNumber() || !info[2].IsNumber()) {
+        Napi::TypeError::New(env, "Expected session handle, fromMs (number) and toMs (number)").ThrowAsJavaScriptException();
+        return env.Null();
     }
-    
-    return state->ready;
+
+    SessionHandle handle;
+    if (!ReadSessionHandle(info[0], &handle)) {
+        return env.Null();
+    }
+
+    double fromMs = info[1].As<Napi::Number>().DoubleValue();
+    double toMs = info[2].As<Napi::Number>().DoubleValue();
+    double resolutionMs = info.Length() > 3 && info[3].IsNumber() ? info[3].As<Napi::Number>().DoubleValue() : 0.0;
+    if (!(fromMs >= 0.0) || !(toMs >= fromMs) || !(resolutionMs >= 0.0)) {
+        Napi::RangeError::New(env, "Expected 0 <= fromMs <= toMs and resolutionMs >= 0").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    std::vector<double> rows;
+    uint32_t resolution = SessionHistory::Instance().Query(
+        handle,
+        static_cast<uint64_t>(fromMs),
+        static_cast<uint64_t>(std::min(toMs, 9007199254740991.0)),
+        static_cast<uint32_t>(std::min(resolutionMs, 4294967295.0)),
+        &rows
+    );
+    if (resolution == 0) {
+        return env.Null();
+    }
+
+    Napi::Float64Array result = Napi::Float64Array::New(env, rows.size());
+    std::copy(rows.begin(), rows.end(), result.Data());
+    return result;
 }
 
-// Sink input callback for application audio streams
-void SinkInputCallback(pa_context* context, const pa_sink_input_info* info, int eol, void* userdata) {
-    PulseState* state = static_cast<PulseState*>(userdata);
-    
-    if (eol > 0) {
-        state->operation_done = true;
-        state->cv.notify_all();
-        return;
+// List the sessions that currently have history, including ended ones
+Napi::Array GetHistorySessionsWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    std::vector<SessionHistory::TrackedSession> sessions = SessionHistory::Instance().GetTrackedSessions();
+    Napi::Array result = Napi::Array::New(env, sessions.size());
+
+    for (size_t i = 0; i < sessions.size(); i++) {
+        Napi::Object sessionObj = Napi::Object::New(env);
+        sessionObj.Set("id", FormatSessionId(sessions[i].handle));
+        sessionObj.Set("handle", static_cast<double>(sessions[i].handle));
+        sessionObj.Set("name", sessions[i].name);
+        sessionObj.Set("active", sessions[i].active);
+        sessionObj.Set("firstMs", static_cast<double>(sessions[i].first_ms));
+        sessionObj.Set("lastMs", static_cast<double>(sessions[i].last_ms));
+
+        result[i] = sessionObj;
     }
-    
-    if (info) {
-        AudioSession session;
-        session.id = std::to_string(info->index);
-        
-        // Get application name
-        if (info->proplist && pa_proplist_contains(info->proplist, PA_PROP_APPLICATION_NAME)) {
-            const char* appName = pa_proplist_gets(info->proplist, PA_PROP_APPLICATION_NAME);
-            if (appName) {
-                session.name = appName;
-            } else {
-                session.name = "Unknown Application";
-            }
-        } else {
-            session.name = "Unknown Application";
+
+    return result;
+}
+
+// Describe a sample spec as { format, rate, channels }, or null if it is not known
+static Napi::Value SampleSpecToObject(Napi::Env env, const pa_sample_spec& spec) {
+    if (!pa_sample_spec_valid(&spec)) {
+        return env.Null();
+    }
+
+    Napi::Object specObj = Napi::Object::New(env);
+    specObj.Set("format", pa_sample_format_to_string(spec.format));
+    specObj.Set("rate", spec.rate);
+    specObj.Set("channels", spec.channels);
+    return specObj;
+}
+
+// Per-stream latency and resampler diagnostics from the live session table:
+// ([{ maxLatencyMs }]) -> [{ id, handle, name, latency, format, flags... }]
+Napi::Value GetStreamDiagnosticsWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    uint64_t maxLatencyUsec = kDefaultMaxStreamLatencyUsec;
+    if (info.Length() > 0 && info[0].IsObject()) {
+        Napi::Value maxLatencyMs = info[0].As<Napi::Object>().Get("maxLatencyMs");
+        if (maxLatencyMs.IsNumber() && maxLatencyMs.As<Napi::Number>().DoubleValue() >= 0.0) {
+            maxLatencyUsec = static_cast<uint64_t>(maxLatencyMs.As<Napi::Number>().DoubleValue() * 1000.0);
         }
-        
-        // Get volume
-        pa_volume_t avgVolume = pa_cvolume_avg(&info->volume);
-        session.volume = (static_cast<float>(avgVolume) * 100.0f) / PA_VOLUME_NORM;
-        
-        // Get mute state
-        session.muted = info->mute == 1;
-        
-        // Add to sessions
-        state->sessions.push_back(session);
-    }
-}
-
-// Sink callback for system audio
-void SinkCallback(pa_context* context, const pa_sink_info* info, int eol, void* userdata) {
-    PulseState* state = static_cast<PulseState*>(userdata);
-    
-    if (eol > 0) {
-        state->operation_done = true;
-        state->cv.notify_all();
+    }
+
+    PulseEngine& engine = PulseEngine::Instance();
+    if (!engine.Start()) {
+        return Napi::Array::New(env, 0);
+    }
+
+    std::vector<StreamDiagnostics> report = CollectStreamDiagnostics(engine.GetSessions(), maxLatencyUsec);
+    Napi::Array result = Napi::Array::New(env, report.size());
+
+    for (size_t i = 0; i < report.size(); i++) {
+        const StreamDiagnostics& stream = report[i];
+        Napi::Object streamObj = Napi::Object::New(env);
+        streamObj.Set("id", FormatSessionId(stream.handle));
+        streamObj.Set("handle", static_cast<double>(stream.handle));
+        streamObj.Set("name", stream.name);
+        streamObj.Set("deviceId", FormatSessionId(stream.device));
+        streamObj.Set("sampleSpec", SampleSpecToObject(env, stream.sample_spec));
+        streamObj.Set("deviceSampleSpec", SampleSpecToObject(env, stream.device_spec));
+        streamObj.Set("resampleMethod", stream.resample_method);
+        streamObj.Set("corked", stream.corked);
+        streamObj.Set("bufferLatencyMs", stream.buffer_usec / 1000.0);
+        streamObj.Set("deviceLatencyMs", stream.device_usec / 1000.0);
+        streamObj.Set("totalLatencyMs", stream.total_usec / 1000.0);
+        streamObj.Set("resampled", stream.resampled);
+        streamObj.Set("remapped", stream.remapped);
+        streamObj.Set("excessiveBuffering", stream.excessive_buffering);
+
+        result[i] = streamObj;
+    }
+
+    return result;
+}
+
+// Listeners for coalesced session changes, by subscription id
+static std::map<SessionChangeNotifier::SubscriptionId, Napi::ThreadSafeFunction> sessionsChangedFunctions;
+
+static void ReleaseSessionsChanged(SessionChangeNotifier::SubscriptionId id) {
+    auto it = sessionsChangedFunctions.find(id);
+    if (it == sessionsChangedFunctions.end()) {
         return;
     }
-    
-    if (info) {
-        AudioSession session;
-        session.id = "system-" + std::to_string(info->index);
-        session.name = info->description ? info->description : "System Output";
-        
-        // Get volume
-        pa_volume_t avgVolume = pa_cvolume_avg(&info->volume);
-        session.volume = (static_cast<float>(avgVolume) * 100.0f) / PA_VOLUME_NORM;
-        
-        // Get mute state
-        session.muted = info->mute == 1;
-        
-        // Add to sessions
-        state->sessions.push_back(session);
-    }
-}
-
-// Success callback for operations
-void SuccessCallback(pa_context* context, int success, void* userdata) {
-    PulseState* state = static_cast<PulseState*>(userdata);
-    state->success = success;
-    state->operation_done = true;
-    state->cv.notify_all();
-}
-
-// Get all audio sessions (system and applications)
-std::vector<AudioSession> GetAudioSessions() {
-    auto state = CreatePulseState();
-    if (!state || !ConnectToPulseAudio(state.get())) {
-        return {};
+
+    // The notifier never calls the sink once Unsubscribe returns
+    SessionChangeNotifier::Instance().Unsubscribe(id);
+    it->second.Release();
+    sessionsChangedFunctions.erase(it);
+}
+
+static void ReleaseAllSessionsChanged() {
+    SessionChangeNotifier::Instance().UnsubscribeAll();
+    for (auto& entry : sessionsChangedFunctions) {
+        entry.second.Release();
     }
-    
-    state->sessions.clear();
-    state->operation_done = false;
-    
-    // Get system audio devices (sinks)
-    pa_operation* op = pa_context_get_sink_info_list(state->context, SinkCallback, state.get());
-    if (!op) {
-        CleanupPulseState(state.get());
-        return {};
+    sessionsChangedFunctions.clear();
+}
+
+// Read an optional { intervalMs } option; throws a TypeError when malformed
+static bool ReadIntervalOption(Napi::Env env, const Napi::CallbackInfo& info, size_t position, uint32_t* interval_ms) {
+    if (info.Length() <= position || info[position].IsUndefined()) {
+        return true;
     }
-    
-    // Wait for operation to complete
-    {
-        std::unique_lock<std::mutex> lock(state->mutex);
-        if (!state->cv.wait_for(lock, std::chrono::seconds(5), [state]() { return state->operation_done; })) {
-            pa_operation_cancel(op);
-            pa_operation_unref(op);
-            CleanupPulseState(state.get());
-            return {};
-        }
+    if (!info[position].IsObject()) {
+        Napi::TypeError::New(env, "Expected options (object)").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    Napi::Value value = info[position].As<Napi::Object>().Get("intervalMs");
+    if (value.IsUndefined()) {
+        return true;
+    }
+    double interval = value.IsNumber() ? value.As<Napi::Number>().DoubleValue() : -1.0;
+    if (!(interval >= 0.0 && interval <= 3600000.0)) {
+        Napi::TypeError::New(env, "Expected intervalMs (0 to 3600000)").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    *interval_ms = static_cast<uint32_t>(interval);
+    return true;
+}
+
+// Subscribe to session changes: callback(changedSessions, removedIds[, { intervalMs }])
+// -> subscription id. Every subscriber's first call carries the whole table;
+// later calls carry deltas spaced according to the activity mode and at
+// least intervalMs apart. Passing null removes every subscriber.
+Napi::Value OnSessionsChangedWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !(info[0].IsFunction() || info[0].IsNull())) {
+        Napi::TypeError::New(env, "Expected callback (function) or null").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    if (info[0].IsNull()) {
+        ReleaseAllSessionsChanged();
+        return env.Undefined();
     }
-    
-    pa_operation_unref(op);
-    state->operation_done = false;
-    
-    // Get application streams (sink inputs)
-    op = pa_context_get_sink_input_info_list(state->context, SinkInputCallback, state.get());
-    if (!op) {
-        CleanupPulseState(state.get());
-        return state->sessions; // Return at least system devices
-    }
-    
-    // Wait for operation to complete
-    {
-        std::unique_lock<std::mutex> lock(state->mutex);
-        if (!state->cv.wait_for(lock, std::chrono::seconds(5), [state]() { return state->operation_done; })) {
-            pa_operation_cancel(op);
-            pa_operation_unref(op);
-            CleanupPulseState(state.get());
-            return state->sessions; // Return what we have so far
+
+    uint32_t intervalMs = 0;
+    if (!ReadIntervalOption(env, info, 1, &intervalMs)) {
+        return env.Undefined();
+    }
+
+    Napi::ThreadSafeFunction function = Napi::ThreadSafeFunction::New(env, info[0].As<Napi::Function>(), "sessionsChanged", 0, 1);
+    function.Unref(env);
+
+    SessionChangeNotifier::SubscriptionId id = SessionChangeNotifier::Instance().Subscribe([function](SessionChangeBatch&& batch) {
+        SessionChangeBatch* data = new SessionChangeBatch(std::move(batch));
+        napi_status status = function.NonBlockingCall(data, [](Napi::Env env, Napi::Function callback, SessionChangeBatch* data) {
+            Napi::Array changed = Napi::Array::New(env, data->changed.size());
+            for (size_t i = 0; i < data->changed.size(); i++) {
+                changed[i] = SessionToObject(env, data->changed[i]);
+            }
+            Napi::Array removed = Napi::Array::New(env, data->removed.size());
+            for (size_t i = 0; i < data->removed.size(); i++) {
+                removed[i] = Napi::String::New(env, FormatSessionId(data->removed[i]));
+            }
+            delete data;
+
+            callback.Call({ changed, removed });
+        });
+        if (status != napi_ok) {
+            delete data;
         }
+    }, intervalMs);
+    sessionsChangedFunctions[id] = function;
+
+    PulseEngine::Instance().Start();
+    return Napi::Number::New(env, id);
+}
+
+// Remove one session change subscriber: (id) -> bool
+Napi::Boolean OffSessionsChangedWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Expected subscription id (number)").ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
     }
-    
-    pa_operation_unref(op);
-    
-    // Run mainloop to process events
-    int retval;
-    if (pa_mainloop_run(state->mainloop, &retval) < 0) {
-        // Handle error
+
+    SessionChangeNotifier::SubscriptionId id = info[0].As<Napi::Number>().Uint32Value();
+    bool found = sessionsChangedFunctions.count(id) > 0;
+    ReleaseSessionsChanged(id);
+    return Napi::Boolean::New(env, found);
+}
+
+// Change a subscriber's minimum spacing between batches: (id, { intervalMs }) -> bool
+Napi::Boolean SetSessionsChangedIntervalWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsObject()) {
+        Napi::TypeError::New(env, "Expected subscription id (number) and options (object)").ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
+    }
+
+    uint32_t intervalMs = 0;
+    if (!ReadIntervalOption(env, info, 1, &intervalMs)) {
+        return Napi::Boolean::New(env, false);
     }
-    
-    auto sessions = state->sessions;
-    CleanupPulseState(state.get());
-    
-    return sessions;
+
+    SessionChangeNotifier::SubscriptionId id = info[0].As<Napi::Number>().Uint32Value();
+    return Napi::Boolean::New(env, SessionChangeNotifier::Instance().SetMinInterval(id, intervalMs));
 }
 
-// Set volume for a specific audio session
-bool SetVolume(const std::string& sessionId, float volume) {
-    if (volume < 0.0f || volume > 100.0f) {
-        return false;
+// Replace the saved mute states the engine enforces: ({ [sessionName]: muted })
+Napi::Value SetMuteRulesWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Expected mute states (object)").ThrowAsJavaScriptException();
+        return env.Undefined();
     }
-    
-    auto state = CreatePulseState();
-    if (!state || !ConnectToPulseAudio(state.get())) {
-        return false;
+
+    Napi::Object states = info[0].As<Napi::Object>();
+    Napi::Array names = states.GetPropertyNames();
+    std::map<std::string, bool> rules;
+    for (uint32_t i = 0; i < names.Length(); i++) {
+        Napi::Value name = names.Get(i);
+        Napi::Value muted = states.Get(name.As<Napi::String>().Utf8Value());
+        if (muted.IsBoolean()) {
+            rules[name.As<Napi::String>().Utf8Value()] = muted.As<Napi::Boolean>().Value();
+        }
+    }
+
+    MuteRuleEnforcer::Instance().SetRules(std::move(rules));
+    return env.Undefined();
+}
+
+// Switch between 'foreground', 'background' and 'suspended'
+Napi::Boolean SetActivityModeWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Expected mode (string)").ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
     }
-    
-    state->operation_done = false;
-    state->success = false;
-    
-    // Convert volume to PulseAudio format
-    pa_volume_t paVolume = (pa_volume_t)((volume / 100.0f) * PA_VOLUME_NORM);
-    
-    pa_operation* op = nullptr;
-    
-    // Check if it's a system device
-    if (sessionId.find("system-") == 0) {
-        std::string indexStr = sessionId.substr(7); // Remove "system-" prefix
-        uint32_t sinkIndex = std::stoul(indexStr);
-        
-        // Create volume structure
-        pa_cvolume cvolume;
-        pa_cvolume_set(&cvolume, 2, paVolume); // Assuming stereo
-        
-        op = pa_context_set_sink_volume_by_index(
-            state->context,
-            sinkIndex,
-            &cvolume,
-            SuccessCallback,
-            state.get()
-        );
+
+    std::string name = info[0].As<Napi::String>().Utf8Value();
+    ActivityMode mode;
+    if (name == "foreground") {
+        mode = ActivityMode::Foreground;
+    } else if (name == "background") {
+        mode = ActivityMode::Background;
+    } else if (name == "suspended") {
+        mode = ActivityMode::Suspended;
     } else {
-        // It's an application stream
-        uint32_t streamIndex = std::stoul(sessionId);
-        
-        // Create volume structure
-        pa_cvolume cvolume;
-        pa_cvolume_set(&cvolume, 2, paVolume); // Assuming stereo
-        
-        op = pa_context_set_sink_input_volume(
-            state->context,
-            streamIndex,
-            &cvolume,
-            SuccessCallback,
-            state.get()
-        );
-    }
-    
-    if (!op) {
-        CleanupPulseState(state.get());
+        Napi::TypeError::New(env, "Expected 'foreground', 'background' or 'suspended'").ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
+    }
+
+    PulseEngine::Instance().SetActivityMode(mode);
+    return Napi::Boolean::New(env, true);
+}
+
+// Report the activity mode and how much work the engine has done in it
+Napi::Object GetActivityStatsWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    PulseEngine& engine = PulseEngine::Instance();
+
+    const char* mode = "foreground";
+    if (engine.GetActivityMode() == ActivityMode::Background) {
+        mode = "background";
+    } else if (engine.GetActivityMode() == ActivityMode::Suspended) {
+        mode = "suspended";
+    }
+
+    Napi::Object stats = Napi::Object::New(env);
+    stats.Set("mode", mode);
+    stats.Set("wakeups", static_cast<double>(engine.GetWakeupCount()));
+    stats.Set("batches", static_cast<double>(SessionChangeNotifier::Instance().GetBatchCount()));
+    stats.Set("subscribers", static_cast<double>(SessionChangeNotifier::Instance().GetSubscriberCount()));
+    stats.Set("ruleEnforcements", static_cast<double>(MuteRuleEnforcer::Instance().GetEnforcementCount()));
+    return stats;
+}
+
+// Read equalizer bands: [{ type: 'lowshelf'|'peaking'|'highshelf', frequency, gain, q }].
+// Throws a TypeError and returns false for malformed input.
+static bool ReadBiquadBands(Napi::Env env, Napi::Value value, std::vector<BiquadBand>* bands) {
+    if (!value.IsArray() || value.As<Napi::Array>().Length() > BiquadCascade::kMaxBands) {
+        Napi::TypeError::New(env, "Expected bands (array of at most 10)").ThrowAsJavaScriptException();
         return false;
     }
-    
-    // Wait for operation to complete
-    {
-        std::unique_lock<std::mutex> lock(state->mutex);
-        if (!state->cv.wait_for(lock, std::chrono::seconds(5), [state]() { return state->operation_done; })) {
-            pa_operation_cancel(op);
-            pa_operation_unref(op);
-            CleanupPulseState(state.get());
+
+    Napi::Array array = value.As<Napi::Array>();
+    for (uint32_t i = 0; i < array.Length(); i++) {
+        Napi::Value entry = array.Get(i);
+        if (!entry.IsObject()) {
+            Napi::TypeError::New(env, "Expected band (object)").ThrowAsJavaScriptException();
             return false;
         }
+
+        Napi::Object bandObj = entry.As<Napi::Object>();
+        Napi::Value type = bandObj.Get("type");
+        Napi::Value frequency = bandObj.Get("frequency");
+        Napi::Value gain = bandObj.Get("gain");
+        Napi::Value q = bandObj.Get("q");
+
+        BiquadBand band;
+        std::string typeName = type.IsString() ? type.As<Napi::String>().Utf8Value() : "";
+        if (typeName == "lowshelf") {
+            band.type = BiquadType::LowShelf;
+        } else if (typeName == "peaking") {
+            band.type = BiquadType::Peaking;
+        } else if (typeName == "highshelf") {
+            band.type = BiquadType::HighShelf;
+        } else {
+            Napi::TypeError::New(env, "Expected band type 'lowshelf', 'peaking' or 'highshelf'").ThrowAsJavaScriptException();
+            return false;
+        }
+        if (!frequency.IsNumber() || !gain.IsNumber() || !(q.IsNumber() || q.IsUndefined())) {
+            Napi::TypeError::New(env, "Expected band frequency and gain (numbers)").ThrowAsJavaScriptException();
+            return false;
+        }
+
+        band.frequency = frequency.As<Napi::Number>().DoubleValue();
+        band.gain_db = gain.As<Napi::Number>().DoubleValue();
+        if (q.IsNumber()) {
+            band.q = q.As<Napi::Number>().DoubleValue();
+        }
+        bands->push_back(band);
+    }
+
+    return true;
+}
+
+// Insert the equalizer in front of an application stream: (handle, bands) -> bool
+Napi::Boolean EnableDspWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    SessionHandle handle;
+    std::vector<BiquadBand> bands;
+    if (info.Length() < 2 || !ReadSessionHandle(info[0], &handle)) {
+        Napi::TypeError::New(env, "Expected session handle and bands").ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
     }
-    
-    pa_operation_unref(op);
-    
-    // Run mainloop to process events
-    int retval;
-    if (pa_mainloop_run(state->mainloop, &retval) < 0) {
-        // Handle error
+    if (!ReadBiquadBands(env, info[1], &bands)) {
+        return Napi::Boolean::New(env, false);
     }
-    
-    bool success = state->success;
-    CleanupPulseState(state.get());
-    
-    return success;
+
+    bool enabled = PulseEngine::Instance().Start() && DspManager::Instance().Enable(handle, bands);
+    return Napi::Boolean::New(env, enabled);
 }
 
-// Set mute state for a specific audio session
-bool SetMute(const std::string& sessionId, bool mute) {
-    auto state = CreatePulseState();
-    if (!state || !ConnectToPulseAudio(state.get())) {
+// Replace the bands of a running equalizer: (handle, bands) -> bool
+Napi::Boolean SetDspBandsWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    SessionHandle handle;
+    std::vector<BiquadBand> bands;
+    if (info.Length() < 2 || !ReadSessionHandle(info[0], &handle)) {
+        Napi::TypeError::New(env, "Expected session handle and bands").ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
+    }
+    if (!ReadBiquadBands(env, info[1], &bands)) {
+        return Napi::Boolean::New(env, false);
+    }
+
+    return Napi::Boolean::New(env, DspManager::Instance().SetBands(handle, bands));
+}
+
+// Remove the equalizer and return the stream to its device: (handle) -> bool
+Napi::Boolean DisableDspWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    SessionHandle handle;
+    if (info.Length() < 1 || !ReadSessionHandle(info[0], &handle)) {
+        Napi::TypeError::New(env, "Expected session handle").ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
+    }
+
+    return Napi::Boolean::New(env, DspManager::Instance().Disable(handle));
+}
+
+// Report every running equalizer with its CPU cost and added latency
+Napi::Array GetDspStatsWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    std::vector<DspStats> stats = DspManager::Instance().GetStats();
+    Napi::Array result = Napi::Array::New(env, stats.size());
+
+    for (size_t i = 0; i < stats.size(); i++) {
+        const DspStats& item = stats[i];
+        Napi::Object itemObj = Napi::Object::New(env);
+        itemObj.Set("id", FormatSessionId(item.handle));
+        itemObj.Set("handle", static_cast<double>(item.handle));
+        itemObj.Set("name", item.name);
+        itemObj.Set("rate", item.rate);
+        itemObj.Set("channels", item.channels);
+        itemObj.Set("bands", static_cast<double>(item.bands));
+        itemObj.Set("processedFrames", static_cast<double>(item.processed_frames));
+        itemObj.Set("cpuLoad", item.cpu_load);
+        itemObj.Set("latencyMs", item.latency_usec / 1000.0);
+        itemObj.Set("underflows", item.underflows);
+        itemObj.Set("overflows", item.overflows);
+
+        result[i] = itemObj;
+    }
+
+    return result;
+}
+
+// Spectrum buffers handed out by openSpectrum, shared by every viewer of a
+// session. Only the JS thread writes them, in readSpectrum.
+struct SpectrumView {
+    Napi::Reference<Napi::Float32Array> buffer;
+    uint32_t viewers;
+    uint32_t bins;
+};
+static std::map<SessionHandle, SpectrumView> spectrumViews;
+
+// Find a session's spectrum view. A view whose analyzer ended with its session
+// is dropped, leaving its array at the floor, so a stream that reuses the
+// handle gets a fresh analyzer and array.
+static std::map<SessionHandle, SpectrumView>::iterator FindSpectrumView(SessionHandle handle) {
+    auto view = spectrumViews.find(handle);
+    if (view == spectrumViews.end() || SpectrumAnalyzer::Instance().IsRunning(handle)) {
+        return view;
+    }
+
+    Napi::Float32Array buffer = view->second.buffer.Value();
+    std::fill(buffer.Data(), buffer.Data() + buffer.ElementLength(), kSpectrumFloorDb);
+    spectrumViews.erase(view);
+    return spectrumViews.end();
+}
+
+// Read an optional positive integer option; throws and returns false if it is malformed
+static bool ReadUintOption(Napi::Env env, Napi::Object options, const char* name, uint32_t* value) {
+    Napi::Value option = options.Get(name);
+    if (option.IsUndefined()) {
+        return true;
+    }
+
+    double number = option.IsNumber() ? option.As<Napi::Number>().DoubleValue() : -1.0;
+    if (!(number >= 1.0 && number <= 1e6) || number != std::floor(number)) {
+        Napi::TypeError::New(env, std::string("Expected ") + name + " (positive integer)").ThrowAsJavaScriptException();
         return false;
     }
-    
-    state->operation_done = false;
-    state->success = false;
-    
-    pa_operation* op = nullptr;
-    
-    // Check if it's a system device
-    if (sessionId.find("system-") == 0) {
-        std::string indexStr = sessionId.substr(7); // Remove "system-" prefix
-        uint32_t sinkIndex = std::stoul(indexStr);
-        
-        op = pa_context_set_sink_mute_by_index(
-            state->context,
-            sinkIndex,
-            mute ? 1 : 0,
-            SuccessCallback,
-            state.get()
-        );
+    *value = static_cast<uint32_t>(number);
+    return true;
+}
+
+// Start (or join) the live spectrum of an application stream:
+// (handle[, { bins, frameRate, fftSize, sampleRate }]) -> Float32Array | null.
+// The array holds `bins` log-spaced magnitudes in dBFS, refreshed by
+// readSpectrum; every viewer of a session shares it.
+Napi::Value OpenSpectrumWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    SessionHandle handle;
+    if (info.Length() < 1 || !ReadSessionHandle(info[0], &handle)) {
+        Napi::TypeError::New(env, "Expected session handle").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    auto view = FindSpectrumView(handle);
+    if (view != spectrumViews.end()) {
+        view->second.viewers++;
+        return view->second.buffer.Value();
+    }
+
+    SpectrumOptions options;
+    AudioSession session;
+    if (PulseEngine::Instance().GetSession(handle, &session) && session.sample_spec.rate > 0) {
+        options.sample_rate = session.sample_spec.rate;
+    }
+    if (info.Length() > 1 && info[1].IsObject()) {
+        Napi::Object optionsObj = info[1].As<Napi::Object>();
+        if (!ReadUintOption(env, optionsObj, "bins", &options.bins) ||
+            !ReadUintOption(env, optionsObj, "frameRate", &options.frame_rate) ||
+            !ReadUintOption(env, optionsObj, "fftSize", &options.fft_size) ||
+            !ReadUintOption(env, optionsObj, "sampleRate", &options.sample_rate)) {
+            return env.Null();
+        }
+    }
+    if (options.bins > 512 || options.frame_rate > 60 || !RealFft::IsValidSize(options.fft_size) ||
+        options.sample_rate < 8000 || options.sample_rate > 192000) {
+        Napi::TypeError::New(env, "Expected bins <= 512, frameRate <= 60, fftSize a power of two (64-16384) and sampleRate 8000-192000").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    // The analyzer keeps its frames in native memory and readSpectrum copies
+    // them in on this thread, so JS may transfer or detach the array freely
+    if (!SpectrumAnalyzer::Instance().Start(handle, options)) {
+        return env.Null();
+    }
+    Napi::Float32Array buffer = Napi::Float32Array::New(env, options.bins);
+    uint64_t sequence;
+    SpectrumAnalyzer::Instance().Read(handle, buffer.Data(), &sequence);
+
+    SpectrumView entry;
+    entry.buffer = Napi::Persistent(buffer);
+    entry.viewers = 1;
+    entry.bins = options.bins;
+    spectrumViews.emplace(handle, std::move(entry));
+    return buffer;
+}
+
+// Copy the latest spectrum frame into the session's array:
+// (handle) -> number | null. Returns the frame's sequence number, which grows
+// by one per frame the analyzer publishes, so an unchanged value means there
+// is nothing new to draw. Null if the spectrum is not open or the array was
+// detached.
+Napi::Value ReadSpectrumWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    SessionHandle handle;
+    if (info.Length() < 1 || !ReadSessionHandle(info[0], &handle)) {
+        Napi::TypeError::New(env, "Expected session handle").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    auto view = FindSpectrumView(handle);
+    if (view == spectrumViews.end()) {
+        return env.Null();
+    }
+    Napi::Float32Array buffer = view->second.buffer.Value();
+    if (buffer.ElementLength() < view->second.bins) {
+        return env.Null();
+    }
+
+    uint64_t sequence;
+    if (!SpectrumAnalyzer::Instance().Read(handle, buffer.Data(), &sequence)) {
+        return env.Null();
+    }
+    return Napi::Number::New(env, static_cast<double>(sequence));
+}
+
+// Leave a session's spectrum; the analyzer stops with its last viewer: (handle) -> bool
+Napi::Boolean CloseSpectrumWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    SessionHandle handle;
+    if (info.Length() < 1 || !ReadSessionHandle(info[0], &handle)) {
+        Napi::TypeError::New(env, "Expected session handle").ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
+    }
+
+    auto view = FindSpectrumView(handle);
+    if (view == spectrumViews.end()) {
+        return Napi::Boolean::New(env, false);
+    }
+    if (--view->second.viewers == 0) {
+        SpectrumAnalyzer::Instance().Stop(handle);
+        spectrumViews.erase(view);
+    }
+    return Napi::Boolean::New(env, true);
+}
+
+// Report every running analyzer: frames computed, idle ticks and CPU per frame
+Napi::Array GetSpectrumStatsWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    std::vector<SpectrumStats> stats = SpectrumAnalyzer::Instance().GetStats();
+    Napi::Array result = Napi::Array::New(env, stats.size());
+
+    for (size_t i = 0; i < stats.size(); i++) {
+        const SpectrumStats& item = stats[i];
+        auto view = spectrumViews.find(item.handle);
+
+        Napi::Object itemObj = Napi::Object::New(env);
+        itemObj.Set("id", FormatSessionId(item.handle));
+        itemObj.Set("handle", static_cast<double>(item.handle));
+        itemObj.Set("viewers", view != spectrumViews.end() ? view->second.viewers : 0);
+        itemObj.Set("bins", item.bins);
+        itemObj.Set("frameRate", item.frame_rate);
+        itemObj.Set("fftSize", item.fft_size);
+        itemObj.Set("sampleRate", item.sample_rate);
+        itemObj.Set("paused", item.paused);
+        itemObj.Set("connected", item.connected);
+        itemObj.Set("frames", static_cast<double>(item.frames));
+        itemObj.Set("idleFrames", static_cast<double>(item.idle_frames));
+        itemObj.Set("cpuUsecPerFrame", item.cpu_usec_per_frame);
+
+        result[i] = itemObj;
+    }
+
+    return result;
+}
+
+// Start writing the engine's event stream to a trace file: (path) -> bool
+Napi::Boolean StartTraceRecordingWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Expected trace path (string)").ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
+    }
+
+    std::string path = info[0].As<Napi::String>().Utf8Value();
+    return Napi::Boolean::New(env, EventTraceRecorder::Instance().Start(path));
+}
+
+// Close the trace file: () -> { events, bytes, durationMs } or null when not recording
+Napi::Value StopTraceRecordingWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    EventTraceRecorder::Summary summary;
+    if (!EventTraceRecorder::Instance().Stop(&summary)) {
+        return env.Null();
+    }
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("events", static_cast<double>(summary.events));
+    result.Set("bytes", static_cast<double>(summary.bytes));
+    result.Set("durationMs", summary.duration_usec / 1000.0);
+    return result;
+}
+
+// Detach from the server and drive the session table from a trace:
+// (path, { speed }) -> bool. Speed 1 is real time, 0 as fast as possible.
+Napi::Boolean StartReplayWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Expected trace path (string)").ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
+    }
+
+    double speed = 1.0;
+    if (info.Length() > 1 && info[1].IsObject()) {
+        Napi::Value speedValue = info[1].As<Napi::Object>().Get("speed");
+        if (!speedValue.IsUndefined()) {
+            if (!speedValue.IsNumber() || !(speedValue.As<Napi::Number>().DoubleValue() >= 0.0)) {
+                Napi::TypeError::New(env, "Expected speed (non-negative number)").ThrowAsJavaScriptException();
+                return Napi::Boolean::New(env, false);
+            }
+            speed = speedValue.As<Napi::Number>().DoubleValue();
+        }
+    }
+
+    std::string path = info[0].As<Napi::String>().Utf8Value();
+    return Napi::Boolean::New(env, EventTraceReplayer::Instance().Start(path, speed));
+}
+
+// End a replay and reconnect to the server
+Napi::Value StopReplayWrapper(const Napi::CallbackInfo& info) {
+    EventTraceReplayer::Instance().Stop();
+    return info.Env().Undefined();
+}
+
+// Report replay progress: events applied, trace time reached and wall time spent
+Napi::Object GetReplayStatusWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    EventTraceReplayer::Status status = EventTraceReplayer::Instance().GetStatus();
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("active", status.active);
+    result.Set("finished", status.finished);
+    result.Set("speed", status.speed);
+    result.Set("applied", static_cast<double>(status.applied));
+    result.Set("total", static_cast<double>(status.total));
+    result.Set("traceMs", status.trace_usec / 1000.0);
+    result.Set("elapsedMs", status.elapsed_usec / 1000.0);
+    return result;
+}
+
+// Bind a named action to an application-name matcher:
+// (name, { app, volume: step } | { app, mute: true | false | 'toggle' }[, capture]) -> bool.
+// app is case-insensitive and may use '*' and '?'; capture acts on capture streams.
+Napi::Boolean DefineActionWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[0].IsString() || !info[1].IsObject()) {
+        Napi::TypeError::New(env, "Expected action name (string) and action (object)").ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
+    }
+
+    Napi::Object actionObj = info[1].As<Napi::Object>();
+    Napi::Value app = actionObj.Get("app");
+    Napi::Value volume = actionObj.Get("volume");
+    Napi::Value mute = actionObj.Get("mute");
+    Napi::Value capture = actionObj.Get("capture");
+
+    SessionAction action;
+    if (!app.IsString() || !(capture.IsUndefined() || capture.IsBoolean())) {
+        Napi::TypeError::New(env, "Expected app (string) and optional capture (boolean)").ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
+    }
+    action.pattern = app.As<Napi::String>().Utf8Value();
+    action.capture = capture.IsBoolean() && capture.As<Napi::Boolean>().Value();
+
+    if (volume.IsNumber() && mute.IsUndefined()) {
+        action.type = SessionActionType::VolumeStep;
+        action.step = volume.As<Napi::Number>().FloatValue();
+    } else if (mute.IsBoolean() && volume.IsUndefined()) {
+        action.type = mute.As<Napi::Boolean>().Value() ? SessionActionType::Mute : SessionActionType::Unmute;
+    } else if (mute.IsString() && mute.As<Napi::String>().Utf8Value() == "toggle" && volume.IsUndefined()) {
+        action.type = SessionActionType::ToggleMute;
     } else {
-        // It's an application stream
-        uint32_t streamIndex = std::stoul(sessionId);
-        
-        op = pa_context_set_sink_input_mute(
-            state->context,
-            streamIndex,
-            mute ? 1 : 0,
-            SuccessCallback,
-            state.get()
-        );
-    }
-    
-    if (!op) {
-        CleanupPulseState(state.get());
+        Napi::TypeError::New(env, "Expected either volume (number) or mute (boolean or 'toggle')").ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
+    }
+
+    std::string name = info[0].As<Napi::String>().Utf8Value();
+    return Napi::Boolean::New(env, SessionActions::Instance().Define(name, action));
+}
+
+// Forget a named action: (name) -> bool
+Napi::Boolean RemoveActionWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Expected action name (string)").ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
+    }
+
+    return Napi::Boolean::New(env, SessionActions::Instance().Remove(info[0].As<Napi::String>().Utf8Value()));
+}
+
+// Run a named action without waiting: (name[, callback]) -> bool, false when
+// no action has that name. callback({ matched, applied, names, elapsedMs[, muted] })
+// follows once the server has acknowledged or refused every request.
+Napi::Boolean RunActionWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Expected action name (string)").ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
+    }
+    if (info.Length() > 1 && !info[1].IsUndefined() && !info[1].IsFunction()) {
+        Napi::TypeError::New(env, "Expected callback (function)").ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
+    }
+
+    // The action completes on the engine thread; the callback, if any, gets
+    // the result through a one-shot thread-safe function
+    SessionActions::ResultCallback done;
+    Napi::ThreadSafeFunction function;
+    bool hasCallback = info.Length() > 1 && info[1].IsFunction();
+    if (hasCallback) {
+        function = Napi::ThreadSafeFunction::New(env, info[1].As<Napi::Function>(), "runAction", 0, 1);
+        function.Unref(env);
+        done = [function](SessionActionResult&& outcome) mutable {
+            SessionActionResult* data = new SessionActionResult(std::move(outcome));
+            napi_status status = function.NonBlockingCall(data, [](Napi::Env env, Napi::Function callback, SessionActionResult* data) {
+                Napi::Array names = Napi::Array::New(env, data->names.size());
+                for (size_t i = 0; i < data->names.size(); i++) {
+                    names[i] = Napi::String::New(env, data->names[i]);
+                }
+
+                Napi::Object result = Napi::Object::New(env);
+                result.Set("matched", static_cast<double>(data->matched));
+                result.Set("applied", static_cast<double>(data->applied));
+                result.Set("names", names);
+                result.Set("elapsedMs", data->elapsed_usec / 1000.0);
+                if (data->type != SessionActionType::VolumeStep) {
+                    result.Set("muted", data->muted);
+                }
+                delete data;
+
+                callback.Call({ result });
+            });
+            if (status != napi_ok) {
+                delete data;
+            }
+            function.Release();
+        };
+    }
+
+    bool found = SessionActions::Instance().Run(info[0].As<Napi::String>().Utf8Value(), std::move(done));
+    if (!found && hasCallback) {
+        function.Release();
+    }
+    return Napi::Boolean::New(env, found);
+}
+
+// Report runs and press-to-applied latency per action
+Napi::Array GetActionStatsWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    std::vector<SessionActionStats> stats = SessionActions::Instance().GetStats();
+    Napi::Array result = Napi::Array::New(env, stats.size());
+
+    for (size_t i = 0; i < stats.size(); i++) {
+        Napi::Object itemObj = Napi::Object::New(env);
+        itemObj.Set("name", stats[i].name);
+        itemObj.Set("runs", static_cast<double>(stats[i].runs));
+        itemObj.Set("lastMs", stats[i].last_usec / 1000.0);
+        itemObj.Set("maxMs", stats[i].max_usec / 1000.0);
+        result[i] = itemObj;
+    }
+
+    return result;
+}
+
+// Read an encoded scene from a Buffer; throws a TypeError when malformed
+static bool ReadScene(Napi::Env env, const Napi::CallbackInfo& info, std::vector<SceneEntry>* entries) {
+    if (info.Length() < 1 || !info[0].IsBuffer()) {
+        Napi::TypeError::New(env, "Expected scene (Buffer)").ThrowAsJavaScriptException();
         return false;
     }
-    
-    // Wait for operation to complete
-    {
-        std::unique_lock<std::mutex> lock(state->mutex);
-        if (!state->cv.wait_for(lock, std::chrono::seconds(5), [state]() { return state->operation_done; })) {
-            pa_operation_cancel(op);
-            pa_operation_unref(op);
-            CleanupPulseState(state.get());
-            return false;
-        }
+
+    Napi::Buffer<uint8_t> buffer = info[0].As<Napi::Buffer<uint8_t>>();
+    if (!DecodeScene(buffer.Data(), buffer.Length(), entries)) {
+        Napi::TypeError::New(env, "Malformed or unsupported scene").ThrowAsJavaScriptException();
+        return false;
+    }
+    return true;
+}
+
+// Capture the volume and mute state of every session: () -> Buffer
+Napi::Value CaptureSceneWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    std::string encoded = EncodeScene(CaptureScene(GetAudioSessions()));
+    return Napi::Buffer<uint8_t>::Copy(env, reinterpret_cast<const uint8_t*>(encoded.data()), encoded.size());
+}
+
+// Apply a captured scene as one burst of the requests that differ from live state:
+// (scene) -> { matched, changed, applied, muteRules, elapsedMs }, or null when
+// the server is unavailable
+Napi::Value RestoreSceneWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    std::vector<SceneEntry> entries;
+    if (!ReadScene(env, info, &entries)) {
+        return env.Null();
+    }
+
+    SceneApplyResult outcome;
+    if (!ApplyScene(entries, &outcome)) {
+        return env.Null();
     }
-    
-    pa_operation_unref(op);
-    
-    // Run mainloop to process events
-    int retval;
-    if (pa_mainloop_run(state->mainloop, &retval) < 0) {
-        // Handle error
-    }
-    
-    bool success = state->success;
-    CleanupPulseState(state.get());
-    
-    return success;
-}
\ No newline at end of file
+
+    Napi::Object muteRules = Napi::Object::New(env);
+    for (const auto& rule : outcome.mute_rules) {
+        muteRules.Set(rule.first, rule.second);
+    }
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("matched", static_cast<double>(outcome.matched));
+    result.Set("changed", static_cast<double>(outcome.changed));
+    result.Set("applied", static_cast<double>(outcome.applied));
+    result.Set("muteRules", muteRules);
+    result.Set("elapsedMs", outcome.elapsed_usec / 1000.0);
+    return result;
+}
+
+// List a scene's entries: (scene) -> [{ kind, name, volume, muted }]
+Napi::Value DescribeSceneWrapper(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    std::vector<SceneEntry> entries;
+    if (!ReadScene(env, info, &entries)) {
+        return env.Null();
+    }
+
+    Napi::Array result = Napi::Array::New(env, entries.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+        Napi::Object entryObj = Napi::Object::New(env);
+        entryObj.Set("kind", SessionKindName(entries[i].kind));
+        entryObj.Set("name", entries[i].name);
+        entryObj.Set("volume", entries[i].volume);
+        entryObj.Set("muted", entries[i].muted);
+        result[i] = entryObj;
+    }
+    return result;
+}
+
+// Stop the engine thread before the environment goes away
+static void CleanupModule(void* arg) {
+    ReleaseAllSessionsChanged();
+    EventTraceRecorder::Instance().Stop(nullptr);
+    EventTraceReplayer::Instance().Stop();
+    SpectrumAnalyzer::Instance().StopAll();
+    spectrumViews.clear();
+    DspManager::Instance().DisableAll();
+    AudioStreamLoop::Instance().Stop();
+    PulseEngine::Instance().Stop();
+}
+
+// Initialize Node.js module
+Napi::Object Init(Napi::Env env, Napi::Object exports) {
+    PulseEngine& engine = PulseEngine::Instance();
+    engine.AddObserver(&SessionHistory::Instance());
+    engine.AddObserver(&MuteRuleEnforcer::Instance());
+    engine.AddObserver(&SessionChangeNotifier::Instance());
+    engine.AddObserver(&DspManager::Instance());
+    engine.AddObserver(&SpectrumAnalyzer::Instance());
+    engine.AddActivityListener(&SessionChangeNotifier::Instance());
+    engine.AddActivityListener(&SpectrumAnalyzer::Instance());
+    engine.AddObserver(&EventTraceRecorder::Instance());
+    engine.AddSubscriptionListener(&EventTraceRecorder::Instance());
+    napi_add_env_cleanup_hook(env, CleanupModule, nullptr);
+
+    exports.Set("getAudioSessions", Napi::Function::New(env, GetAudioSessionsWrapper));
+    exports.Set("setVolume", Napi::Function::New(env, SetVolumeWrapper));
+    exports.Set("setMute", Napi::Function::New(env, SetMuteWrapper));
+    exports.Set("setBalance", Napi::Function::New(env, SetBalanceWrapper));
+    exports.Set("moveSessions", Napi::Function::New(env, MoveSessionsWrapper));
+    exports.Set("parseSessionId", Napi::Function::New(env, ParseSessionIdWrapper));
+    exports.Set("getSessionHistory", Napi::Function::New(env, GetSessionHistoryWrapper));
+    exports.Set("getHistorySessions", Napi::Function::New(env, GetHistorySessionsWrapper));
+    exports.Set("getStreamDiagnostics", Napi::Function::New(env, GetStreamDiagnosticsWrapper));
+    exports.Set("onSessionsChanged", Napi::Function::New(env, OnSessionsChangedWrapper));
+    exports.Set("offSessionsChanged", Napi::Function::New(env, OffSessionsChangedWrapper));
+    exports.Set("setSessionsChangedInterval", Napi::Function::New(env, SetSessionsChangedIntervalWrapper));
+    exports.Set("setMuteRules", Napi::Function::New(env, SetMuteRulesWrapper));
+    exports.Set("setActivityMode", Napi::Function::New(env, SetActivityModeWrapper));
+    exports.Set("getActivityStats", Napi::Function::New(env, GetActivityStatsWrapper));
+    exports.Set("enableDsp", Napi::Function::New(env, EnableDspWrapper));
+    exports.Set("setDspBands", Napi::Function::New(env, SetDspBandsWrapper));
+    exports.Set("disableDsp", Napi::Function::New(env, DisableDspWrapper));
+    exports.Set("getDspStats", Napi::Function::New(env, GetDspStatsWrapper));
+    exports.Set("openSpectrum", Napi::Function::New(env, OpenSpectrumWrapper));
+    exports.Set("readSpectrum", Napi::Function::New(env, ReadSpectrumWrapper));
+    exports.Set("closeSpectrum", Napi::Function::New(env, CloseSpectrumWrapper));
+    exports.Set("getSpectrumStats", Napi::Function::New(env, GetSpectrumStatsWrapper));
+    exports.Set("startTraceRecording", Napi::Function::New(env, StartTraceRecordingWrapper));
+    exports.Set("stopTraceRecording", Napi::Function::New(env, StopTraceRecordingWrapper));
+    exports.Set("startReplay", Napi::Function::New(env, StartReplayWrapper));
+    exports.Set("stopReplay", Napi::Function::New(env, StopReplayWrapper));
+    exports.Set("getReplayStatus", Napi::Function::New(env, GetReplayStatusWrapper));
+    exports.Set("defineAction", Napi::Function::New(env, DefineActionWrapper));
+    exports.Set("removeAction", Napi::Function::New(env, RemoveActionWrapper));
+    exports.Set("runAction", Napi::Function::New(env, RunActionWrapper));
+    exports.Set("getActionStats", Napi::Function::New(env, GetActionStatsWrapper));
+    exports.Set("captureScene", Napi::Function::New(env, CaptureSceneWrapper));
+    exports.Set("restoreScene", Napi::Function::New(env, RestoreSceneWrapper));
+    exports.Set("describeScene", Napi::Function::New(env, DescribeSceneWrapper));
+
+    Napi::Array historyColumns = Napi::Array::New(env, kHistoryColumnCount);
+    const char* columnNames[kHistoryColumnCount] = { "time", "volume", "volumeMin", "volumeMax", "muted", "peak" };
+    for (uint32_t i = 0; i < kHistoryColumnCount; i++) {
+        historyColumns[i] = Napi::String::New(env, columnNames[i]);
+    }
+    exports.Set("historyColumns", historyColumns);
+
+    return exports;
+}
+
+NODE_API_MODULE(linux_audio_controller, Init)
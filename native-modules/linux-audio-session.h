@@ -0,0 +1,262 @@
+#pragma once
+
+#include <pulse/pulseaudio.h>
+#include <string>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+
+// Kind of PulseAudio object a session refers to
+enum class SessionKind : uint32_t {
+    Invalid = 0,
+    Sink = 1,       // Output device ("system-<index>")
+    SinkInput = 2,  // Application playback stream ("<index>")
+    Source = 3,     // Input device ("source-<index>")
+    SourceOutput = 4 // Application capture stream ("source-output-<index>")
+};
+
+// Opaque session handle: kind in the upper 32 bits, PulseAudio index in the lower 32.
+// The largest value stays below 2^53, so handles round-trip through a JS number unchanged.
+typedef uint64_t SessionHandle;
+const SessionHandle kInvalidSessionHandle = 0;
+
+inline SessionHandle MakeSessionHandle(SessionKind kind, uint32_t index) {
+    return (static_cast<uint64_t>(kind) << 32) | index;
+}
+
+inline SessionKind GetHandleKind(SessionHandle handle) {
+    return static_cast<SessionKind>(handle >> 32);
+}
+
+inline uint32_t GetHandleIndex(SessionHandle handle) {
+    return static_cast<uint32_t>(handle & 0xFFFFFFFFu);
+}
+
+inline bool IsValidSessionHandle(SessionHandle handle) {
+    uint64_t kind = handle >> 32;
+    return kind >= static_cast<uint64_t>(SessionKind::Sink) &&
+           kind <= static_cast<uint64_t>(SessionKind::SourceOutput) &&
+           GetHandleIndex(handle) != PA_INVALID_INDEX;
+}
+
+// Streams (sink inputs, source outputs) as opposed to devices
+inline bool IsStreamKind(SessionKind kind) {
+    return kind == SessionKind::SinkInput || kind == SessionKind::SourceOutput;
+}
+
+// Kind of device a stream of the given kind attaches to
+inline SessionKind DeviceKindFor(SessionKind kind) {
+    switch (kind) {
+        case SessionKind::SinkInput:
+            return SessionKind::Sink;
+        case SessionKind::SourceOutput:
+            return SessionKind::Source;
+        default:
+            return SessionKind::Invalid;
+    }
+}
+
+// Parse a decimal PulseAudio index without throwing
+inline bool ParseIndex(const char* text, uint32_t* index) {
+    if (!text || *text < '0' || *text > '9') {
+        return false;
+    }
+
+    errno = 0;
+    char* end = nullptr;
+    unsigned long long value = std::strtoull(text, &end, 10);
+    if (errno != 0 || *end != '\0' || value >= PA_INVALID_INDEX) {
+        return false;
+    }
+
+    *index = static_cast<uint32_t>(value);
+    return true;
+}
+
+// Convert a legacy string id ("system-3", "source-1", "source-output-5" or
+// "42") to a handle.
+// Returns false for malformed ids instead of throwing.
+inline bool ParseSessionId(const std::string& sessionId, SessionHandle* handle) {
+    SessionKind kind = SessionKind::SinkInput;
+    const char* indexText = sessionId.c_str();
+
+    if (sessionId.compare(0, 14, "source-output-") == 0) {
+        kind = SessionKind::SourceOutput;
+        indexText += 14;
+    } else if (sessionId.compare(0, 7, "system-") == 0) {
+        kind = SessionKind::Sink;
+        indexText += 7;
+    } else if (sessionId.compare(0, 7, "source-") == 0) {
+        kind = SessionKind::Source;
+        indexText += 7;
+    }
+
+    uint32_t index;
+    if (!ParseIndex(indexText, &index)) {
+        return false;
+    }
+
+    *handle = MakeSessionHandle(kind, index);
+    return true;
+}
+
+// Convert a handle back to its legacy string id
+inline std::string FormatSessionId(SessionHandle handle) {
+    std::string index = std::to_string(GetHandleIndex(handle));
+
+    switch (GetHandleKind(handle)) {
+        case SessionKind::Sink:
+            return "system-" + index;
+        case SessionKind::Source:
+            return "source-" + index;
+        case SessionKind::SourceOutput:
+            return "source-output-" + index;
+        default:
+            return index;
+    }
+}
+
+// Prefix of the sinks AmpCore creates for itself, and the stream property that
+// marks AmpCore's own streams. Such objects never appear as sessions.
+const char* const kInternalSinkPrefix = "ampcore_";
+const char* const kInternalStreamProperty = "ampcore.internal";
+
+inline bool IsInternalSink(const pa_sink_info* info) {
+    return info->name && std::string(info->name).compare(0, 8, kInternalSinkPrefix) == 0;
+}
+
+inline bool IsInternalStream(const pa_proplist* proplist) {
+    return proplist && pa_proplist_contains(proplist, kInternalStreamProperty);
+}
+
+// Sink monitors are sources too, but they are not capture devices
+inline bool IsMonitorSource(const pa_source_info* info) {
+    return info->monitor_of_sink != PA_INVALID_INDEX;
+}
+
+// Structure to hold audio session information
+struct AudioSession {
+    SessionHandle handle = kInvalidSessionHandle;
+    std::string id;
+    std::string name;
+    float volume = 0.0f;        // Loudest channel, 0-100+ percent
+    bool muted = false;
+
+    // Per-channel volume and the positions it applies to, as last reported.
+    // Volume changes start from these, so they need no extra query. Both are
+    // empty (0 channels) for streams without a volume of their own.
+    pa_cvolume cvolume = {};
+    pa_channel_map channel_map = {};
+
+    // Stream diagnostics, refreshed with every table update
+    uint32_t device_index = PA_INVALID_INDEX; // Sink a stream plays to, or source it records from
+    pa_sample_spec sample_spec = { PA_SAMPLE_INVALID, 0, 0 };
+    uint64_t buffer_usec = 0;   // Stream buffer (streams) or configured latency (sinks)
+    uint64_t device_usec = 0;   // Device latency seen by the stream (sink_usec) or the sink itself
+    std::string resample_method;
+    bool corked = false;
+};
+
+// Convert a PulseAudio volume to the 0-100 scale used by the UI. The loudest
+// channel is the session's volume, so balance and fade leave it unchanged.
+inline float ToPercentVolume(const pa_cvolume& volume) {
+    pa_volume_t maxVolume = pa_cvolume_max(&volume);
+    return (static_cast<float>(maxVolume) * 100.0f) / PA_VOLUME_NORM;
+}
+
+inline pa_volume_t FromPercentVolume(float percent) {
+    return static_cast<pa_volume_t>((percent / 100.0f) * PA_VOLUME_NORM);
+}
+
+// Cache the per-channel volume, keeping it only when it matches the map
+inline void SetChannelVolumes(AudioSession* session, const pa_cvolume& volume, const pa_channel_map& map) {
+    if (pa_cvolume_valid(&volume) && pa_channel_map_valid(&map) && volume.channels == map.channels) {
+        session->cvolume = volume;
+        session->channel_map = map;
+    }
+}
+
+// Build a session record from a sink (system output device)
+inline AudioSession MakeSinkSession(const pa_sink_info* info) {
+    AudioSession session;
+    session.handle = MakeSessionHandle(SessionKind::Sink, info->index);
+    session.id = FormatSessionId(session.handle);
+    session.name = info->description ? info->description : "System Output";
+    session.volume = ToPercentVolume(info->volume);
+    session.muted = info->mute == 1;
+    SetChannelVolumes(&session, info->volume, info->channel_map);
+
+    session.device_index = info->index;
+    session.sample_spec = info->sample_spec;
+    session.buffer_usec = info->configured_latency;
+    session.device_usec = info->latency;
+    return session;
+}
+
+// Application name from a stream's property list
+inline std::string GetApplicationName(const pa_proplist* proplist) {
+    const char* appName = nullptr;
+    if (proplist && pa_proplist_contains(proplist, PA_PROP_APPLICATION_NAME)) {
+        appName = pa_proplist_gets(proplist, PA_PROP_APPLICATION_NAME);
+    }
+    return appName ? appName : "Unknown Application";
+}
+
+// Build a session record from a sink input (application stream)
+inline AudioSession MakeSinkInputSession(const pa_sink_input_info* info) {
+    AudioSession session;
+    session.handle = MakeSessionHandle(SessionKind::SinkInput, info->index);
+    session.id = FormatSessionId(session.handle);
+    session.name = GetApplicationName(info->proplist);
+
+    session.volume = ToPercentVolume(info->volume);
+    session.muted = info->mute == 1;
+    if (info->has_volume) {
+        SetChannelVolumes(&session, info->volume, info->channel_map);
+    }
+
+    session.device_index = info->sink;
+    session.sample_spec = info->sample_spec;
+    session.buffer_usec = info->buffer_usec;
+    session.device_usec = info->sink_usec;
+    session.resample_method = info->resample_method ? info->resample_method : "";
+    session.corked = info->corked != 0;
+    return session;
+}
+
+// Build a session record from a source (system input device)
+inline AudioSession MakeSourceSession(const pa_source_info* info) {
+    AudioSession session;
+    session.handle = MakeSessionHandle(SessionKind::Source, info->index);
+    session.id = FormatSessionId(session.handle);
+    session.name = info->description ? info->description : "System Input";
+    session.volume = ToPercentVolume(info->volume);
+    session.muted = info->mute == 1;
+    SetChannelVolumes(&session, info->volume, info->channel_map);
+
+    session.device_index = info->index;
+    session.sample_spec = info->sample_spec;
+    session.device_usec = info->latency;
+    return session;
+}
+
+// Build a session record from a source output (application capture stream)
+inline AudioSession MakeSourceOutputSession(const pa_source_output_info* info) {
+    AudioSession session;
+    session.handle = MakeSessionHandle(SessionKind::SourceOutput, info->index);
+    session.id = FormatSessionId(session.handle);
+    session.name = GetApplicationName(info->proplist);
+    session.volume = ToPercentVolume(info->volume);
+    session.muted = info->mute == 1;
+    if (info->has_volume) {
+        SetChannelVolumes(&session, info->volume, info->channel_map);
+    }
+
+    session.device_index = info->source;
+    session.sample_spec = info->sample_spec;
+    session.buffer_usec = info->buffer_usec;
+    session.device_usec = info->source_usec;
+    session.resample_method = info->resample_method ? info->resample_method : "";
+    session.corked = info->corked != 0;
+    return session;
+}
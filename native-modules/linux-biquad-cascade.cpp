@@ -0,0 +1,144 @@
+#include "linux-biquad-cascade.h"
+#include <cmath>
+#include <cstring>
+
+// State values below this are flushed to zero between blocks so a decaying
+// tail never reaches the (much slower) denormal range
+const float kDenormalThreshold = 1e-15f;
+
+bool BiquadCascade::IsValidBand(const BiquadBand& band, double sample_rate) {
+    return std::isfinite(band.frequency) && band.frequency > 0.0 && band.frequency < sample_rate / 2.0 &&
+           std::isfinite(band.gain_db) && std::fabs(band.gain_db) <= kMaxGainDb &&
+           std::isfinite(band.q) && band.q > 0.0;
+}
+
+bool BiquadCascade::Configure(const std::vector<BiquadBand>& bands, double sample_rate, unsigned channels) {
+    if (channels == 0 || channels > kMaxChannels || bands.size() > kMaxBands || !(sample_rate > 0.0)) {
+        return false;
+    }
+    for (const BiquadBand& band : bands) {
+        if (!IsValidBand(band, sample_rate)) {
+            return false;
+        }
+    }
+
+    if (bands.size() != section_count_ || channels != channels_) {
+        section_count_ = bands.size();
+        channels_ = channels;
+        Reset();
+    }
+
+    for (size_t i = 0; i < bands.size(); i++) {
+        const BiquadBand& band = bands[i];
+        double a = std::pow(10.0, band.gain_db / 40.0);
+        double w0 = 2.0 * M_PI * band.frequency / sample_rate;
+        double cosw = std::cos(w0);
+        double alpha = std::sin(w0) / (2.0 * band.q);
+        double b0, b1, b2, a0, a1, a2;
+
+        switch (band.type) {
+            case BiquadType::LowShelf: {
+                double beta = 2.0 * std::sqrt(a) * alpha;
+                b0 = a * ((a + 1) - (a - 1) * cosw + beta);
+                b1 = 2 * a * ((a - 1) - (a + 1) * cosw);
+                b2 = a * ((a + 1) - (a - 1) * cosw - beta);
+                a0 = (a + 1) + (a - 1) * cosw + beta;
+                a1 = -2 * ((a - 1) + (a + 1) * cosw);
+                a2 = (a + 1) + (a - 1) * cosw - beta;
+                break;
+            }
+            case BiquadType::HighShelf: {
+                double beta = 2.0 * std::sqrt(a) * alpha;
+                b0 = a * ((a + 1) + (a - 1) * cosw + beta);
+                b1 = -2 * a * ((a - 1) + (a + 1) * cosw);
+                b2 = a * ((a + 1) + (a - 1) * cosw - beta);
+                a0 = (a + 1) - (a - 1) * cosw + beta;
+                a1 = 2 * ((a - 1) - (a + 1) * cosw);
+                a2 = (a + 1) - (a - 1) * cosw - beta;
+                break;
+            }
+            default:
+                b0 = 1 + alpha * a;
+                b1 = -2 * cosw;
+                b2 = 1 - alpha * a;
+                a0 = 1 + alpha / a;
+                a1 = -2 * cosw;
+                a2 = 1 - alpha / a;
+                break;
+        }
+
+        // Normalise by a0 and broadcast to every lane
+        Section& section = sections_[i];
+        float values[5] = {
+            static_cast<float>(b0 / a0), static_cast<float>(b1 / a0), static_cast<float>(b2 / a0),
+            static_cast<float>(a1 / a0), static_cast<float>(a2 / a0)
+        };
+        Float4* targets[5] = { &section.b0, &section.b1, &section.b2, &section.a1, &section.a2 };
+        for (int c = 0; c < 5; c++) {
+            *targets[c] = BroadcastFloat4(values[c]);
+        }
+    }
+
+    return true;
+}
+
+void BiquadCascade::Reset() {
+    std::memset(z1_, 0, sizeof(z1_));
+    std::memset(z2_, 0, sizeof(z2_));
+}
+
+void BiquadCascade::Process(float* samples, size_t frames) {
+    if (section_count_ == 0 || channels_ == 0) {
+        return;
+    }
+
+    for (unsigned group = 0; group * kLanes < channels_; group++) {
+        ProcessGroup(samples, frames, group);
+    }
+}
+
+void BiquadCascade::ProcessGroup(float* samples, size_t frames, unsigned group) {
+    unsigned first = group * kLanes;
+    unsigned lanes = channels_ - first < kLanes ? channels_ - first : kLanes;
+
+    // Keep the state in locals so the compiler can hold it in registers
+    Float4 z1[kMaxBands];
+    Float4 z2[kMaxBands];
+    for (size_t s = 0; s < section_count_; s++) {
+        z1[s] = z1_[group][s];
+        z2[s] = z2_[group][s];
+    }
+
+    float* frame = samples + first;
+    for (size_t n = 0; n < frames; n++, frame += channels_) {
+        Float4 x = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for (unsigned lane = 0; lane < lanes; lane++) {
+            x[lane] = frame[lane];
+        }
+
+        for (size_t s = 0; s < section_count_; s++) {
+            const Section& section = sections_[s];
+            Float4 y = section.b0 * x + z1[s];
+            z1[s] = section.b1 * x - section.a1 * y + z2[s];
+            z2[s] = section.b2 * x - section.a2 * y;
+            x = y;
+        }
+
+        for (unsigned lane = 0; lane < lanes; lane++) {
+            frame[lane] = x[lane];
+        }
+    }
+
+    for (size_t s = 0; s < section_count_; s++) {
+        for (unsigned lane = 0; lane < kLanes; lane++) {
+            if (std::fabs(z1[s][lane]) < kDenormalThreshold) {
+                z1[s][lane] = 0.0f;
+            }
+            if (std::fabs(z2[s][lane]) < kDenormalThreshold) {
+                z2[s][lane] = 0.0f;
+            }
+        }
+        z1_[group][s] = z1[s];
+        z2_[group][s] = z2[s];
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "linux-simd.h"
+#include <cstddef>
+#include <vector>
+
+// Filter shapes supported by the equalizer (RBJ audio EQ cookbook)
+enum class BiquadType {
+    LowShelf,
+    Peaking,
+    HighShelf
+};
+
+// One equalizer band as configured from JS
+struct BiquadBand {
+    BiquadType type = BiquadType::Peaking;
+    double frequency = 1000.0;  // Hz
+    double gain_db = 0.0;
+    double q = 0.707;
+};
+
+// Cascade of biquad sections run over interleaved float frames.
+//
+// Channels map to the lanes of a Float4, which lets one pass of the cascade
+// filter four channels at once; 5-8 channel layouts take two passes.
+// Each section is a transposed direct form II, which keeps two state values
+// per channel and behaves well with float coefficients.
+class BiquadCascade {
+public:
+    static const unsigned kMaxChannels = 8;
+    static const unsigned kMaxBands = 10;
+    static constexpr double kMaxGainDb = 24.0;
+
+    // Check a band against a sample rate without applying it
+    static bool IsValidBand(const BiquadBand& band, double sample_rate);
+
+    // Compute coefficients for the bands. Filter state is kept when the band
+    // count and layout are unchanged, so live edits do not click. Returns false
+    // (and leaves the cascade untouched) for invalid bands or layouts.
+    bool Configure(const std::vector<BiquadBand>& bands, double sample_rate, unsigned channels);
+
+    // Filter frames in place
+    void Process(float* samples, size_t frames);
+
+    void Reset();
+
+    size_t GetBandCount() const { return section_count_; }
+
+private:
+    struct Section {
+        Float4 b0, b1, b2, a1, a2;
+    };
+
+    static const unsigned kLanes = 4;
+    static const unsigned kMaxGroups = kMaxChannels / kLanes;
+
+    void ProcessGroup(float* samples, size_t frames, unsigned group);
+
+    Section sections_[kMaxBands];
+    Float4 z1_[kMaxGroups][kMaxBands];
+    Float4 z2_[kMaxGroups][kMaxBands];
+    size_t section_count_ = 0;
+    unsigned channels_ = 0;
+};
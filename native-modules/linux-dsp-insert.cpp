@@ -0,0 +1,434 @@
+#include "linux-dsp-insert.h"
+#include "linux-stream-loop.h"
+#include <algorithm>
+
+// Buffer targets; together they bound the added latency
+const pa_usec_t kCaptureFragmentUsec = 5 * PA_USEC_PER_MSEC;
+const pa_usec_t kPlaybackTargetUsec = 10 * PA_USEC_PER_MSEC;
+
+// Frames filtered per pass through the scratch buffer
+const size_t kScratchFrames = 4096;
+
+struct DspManager::Insert {
+    SessionHandle handle = kInvalidSessionHandle;
+    std::string name;
+    pa_sample_spec spec;
+    uint32_t module_index = PA_INVALID_INDEX;
+    uint32_t sink_index = PA_INVALID_INDEX;
+    uint32_t original_sink = PA_INVALID_INDEX;
+    bool routed = false;  // The stream has been seen on the null sink (engine thread)
+
+    // Stream loop lock
+    pa_stream* capture = nullptr;
+    pa_stream* playback = nullptr;
+    BiquadCascade cascade;
+    std::vector<float> scratch;
+    uint64_t processed_frames = 0;
+    uint64_t cpu_nsec = 0;
+    uint32_t underflows = 0;
+    uint32_t overflows = 0;
+};
+
+// Sink index lookup by name; completes once the listing ends (engine thread)
+struct SinkLookup {
+    OperationResult found;
+    PulseEngine::Completion done;
+};
+
+static void SinkLookupCallback(pa_context* context, const pa_sink_info* info, int eol, void* userdata) {
+    SinkLookup* lookup = static_cast<SinkLookup*>(userdata);
+    if (eol == 0) {
+        if (info) {
+            lookup->found.success = true;
+            lookup->found.index = info->index;
+        }
+        return;
+    }
+
+    lookup->done(lookup->found);
+    delete lookup;
+}
+
+DspManager& DspManager::Instance() {
+    static DspManager manager;
+    return manager;
+}
+
+bool DspManager::Enable(SessionHandle handle, const std::vector<BiquadBand>& bands) {
+    std::lock_guard<std::mutex> control(control_mutex_);
+    PulseEngine& engine = PulseEngine::Instance();
+
+    AudioSession session;
+    if (GetHandleKind(handle) != SessionKind::SinkInput || !engine.GetSession(handle, &session)) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(inserts_mutex_);
+        if (inserts_.count(handle)) {
+            return false;
+        }
+    }
+
+    std::unique_ptr<Insert> insert(new Insert());
+    insert->handle = handle;
+    insert->name = session.name;
+    insert->original_sink = session.device_index;
+    insert->spec.format = PA_SAMPLE_FLOAT32NE;
+    insert->spec.rate = session.sample_spec.rate;
+    insert->spec.channels = session.sample_spec.channels;
+    if (!insert->cascade.Configure(bands, insert->spec.rate, insert->spec.channels) ||
+        !AudioStreamLoop::Instance().Start()) {
+        return false;
+    }
+    insert->scratch.resize(kScratchFrames * insert->spec.channels);
+
+    // Private null sink at the stream's own rate and layout, so the
+    // application is not resampled on the way in
+    std::string sinkName = std::string(kInternalSinkPrefix) + "dsp_" + std::to_string(GetHandleIndex(handle));
+    std::string arguments = "sink_name=" + sinkName + " format=float32le rate=" + std::to_string(insert->spec.rate) +
+                            " channels=" + std::to_string(insert->spec.channels) +
+                            " sink_properties=device.description=AmpCore-DSP";
+
+    // The lookup by name follows the load in the same batch, so the server
+    // answers it after the sink exists and both cost one round trip
+    std::vector<PulseEngine::Request> requests;
+    requests.push_back([arguments](pa_context* context, PulseEngine::Completion done) {
+        void* completion = PulseEngine::WrapCompletion(done);
+        PulseEngine::FinishIssue(pa_context_load_module(context, "module-null-sink", arguments.c_str(),
+                                                        PulseEngine::IndexCompletion, completion),
+                                 completion);
+    });
+    requests.push_back([sinkName](pa_context* context, PulseEngine::Completion done) {
+        SinkLookup* lookup = new SinkLookup();
+        lookup->done = done;
+        pa_operation* op = pa_context_get_sink_info_by_name(context, sinkName.c_str(), SinkLookupCallback, lookup);
+        if (op) {
+            pa_operation_unref(op);
+        } else {
+            delete lookup;
+            done(OperationResult());
+        }
+    });
+
+    std::vector<OperationResult> results;
+    engine.RunBatch(std::move(requests), &results);
+    if (results.empty() || !results[0].success) {
+        return false;
+    }
+    insert->module_index = results[0].index;
+    if (!results[1].success) {
+        Teardown(std::move(insert), false, true);
+        return false;
+    }
+    insert->sink_index = results[1].index;
+
+    // Capture from the null sink's monitor and play to the original device
+    AudioStreamLoop& loop = AudioStreamLoop::Instance();
+    bool connected = false;
+    {
+        AudioStreamLoop::Lock lock;
+        insert->capture = loop.CreateStream("AmpCore DSP Capture", "dsp", insert->spec);
+        insert->playback = loop.CreateStream("AmpCore DSP Playback", "dsp", insert->spec);
+
+        if (insert->capture && insert->playback) {
+            pa_buffer_attr captureAttr;
+            captureAttr.maxlength = static_cast<uint32_t>(-1);
+            captureAttr.tlength = static_cast<uint32_t>(-1);
+            captureAttr.prebuf = static_cast<uint32_t>(-1);
+            captureAttr.minreq = static_cast<uint32_t>(-1);
+            captureAttr.fragsize = static_cast<uint32_t>(pa_usec_to_bytes(kCaptureFragmentUsec, &insert->spec));
+
+            pa_buffer_attr playbackAttr = captureAttr;
+            playbackAttr.fragsize = static_cast<uint32_t>(-1);
+            playbackAttr.tlength = static_cast<uint32_t>(pa_usec_to_bytes(kPlaybackTargetUsec, &insert->spec));
+
+            pa_stream_flags_t flags = static_cast<pa_stream_flags_t>(PA_STREAM_ADJUST_LATENCY | PA_STREAM_INTERPOLATE_TIMING |
+                                                                     PA_STREAM_AUTO_TIMING_UPDATE);
+            std::string monitor = sinkName + ".monitor";
+            std::string device = std::to_string(insert->original_sink);
+
+            connected =
+                pa_stream_connect_record(insert->capture, monitor.c_str(), &captureAttr,
+                                         static_cast<pa_stream_flags_t>(flags | PA_STREAM_DONT_MOVE)) == 0 &&
+                pa_stream_connect_playback(insert->playback, device.c_str(), &playbackAttr, flags, nullptr, nullptr) == 0 &&
+                loop.WaitForStream(insert->capture) && loop.WaitForStream(insert->playback);
+        }
+
+        if (connected) {
+            Insert* raw = insert.get();
+            pa_stream_set_read_callback(insert->capture, ReadCallback, raw);
+            pa_stream_set_overflow_callback(insert->capture, OverflowCallback, raw);
+            pa_stream_set_underflow_callback(insert->playback, UnderflowCallback, raw);
+        }
+    }
+    if (!connected) {
+        Teardown(std::move(insert), false, true);
+        return false;
+    }
+
+    // Publish before moving so the observer sees the stream arrive on the sink
+    uint32_t streamIndex = GetHandleIndex(handle);
+    uint32_t sinkIndex = insert->sink_index;
+    {
+        std::lock_guard<std::mutex> lock(inserts_mutex_);
+        inserts_[handle] = std::move(insert);
+    }
+
+    bool moved = engine.RunAndWait([streamIndex, sinkIndex](pa_context* context, PulseEngine::Completion done) {
+        void* completion = PulseEngine::WrapCompletion(done);
+        PulseEngine::FinishIssue(pa_context_move_sink_input_by_index(context, streamIndex, sinkIndex,
+                                                                     PulseEngine::SuccessCompletion, completion),
+                                 completion);
+    });
+    if (!moved) {
+        std::unique_ptr<Insert> failed = TakeInsert(handle);
+        if (failed) {
+            Teardown(std::move(failed), false, true);
+        }
+        return false;
+    }
+    return true;
+}
+
+bool DspManager::SetBands(SessionHandle handle, const std::vector<BiquadBand>& bands) {
+    std::lock_guard<std::mutex> control(control_mutex_);
+    std::lock_guard<std::mutex> lock(inserts_mutex_);
+
+    auto it = inserts_.find(handle);
+    if (it == inserts_.end()) {
+        return false;
+    }
+
+    Insert* insert = it->second.get();
+    AudioStreamLoop::Lock loopLock;
+    return insert->cascade.Configure(bands, insert->spec.rate, insert->spec.channels);
+}
+
+bool DspManager::Disable(SessionHandle handle) {
+    std::lock_guard<std::mutex> control(control_mutex_);
+
+    std::unique_ptr<Insert> insert = TakeInsert(handle);
+    if (!insert) {
+        return false;
+    }
+    Teardown(std::move(insert), true, true);
+    return true;
+}
+
+void DspManager::DisableAll() {
+    std::lock_guard<std::mutex> control(control_mutex_);
+
+    std::map<SessionHandle, std::unique_ptr<Insert>> inserts;
+    {
+        std::lock_guard<std::mutex> lock(inserts_mutex_);
+        inserts.swap(inserts_);
+    }
+    for (auto& entry : inserts) {
+        Teardown(std::move(entry.second), true, true);
+    }
+}
+
+std::unique_ptr<DspManager::Insert> DspManager::TakeInsert(SessionHandle handle) {
+    std::lock_guard<std::mutex> lock(inserts_mutex_);
+
+    auto it = inserts_.find(handle);
+    if (it == inserts_.end()) {
+        return nullptr;
+    }
+    std::unique_ptr<Insert> insert = std::move(it->second);
+    inserts_.erase(it);
+    return insert;
+}
+
+void DspManager::Teardown(std::unique_ptr<Insert> insert, bool restore, bool wait) {
+    // Moving first means the stream does not fall back to the default sink
+    // when its null sink goes away. Without an original device to return
+    // to, it goes to the current default explicitly.
+    uint32_t streamIndex = GetHandleIndex(insert->handle);
+    uint32_t originalSink = insert->original_sink;
+    uint32_t moduleIndex = insert->module_index;
+    PulseEngine::Request request = [streamIndex, restore, originalSink, moduleIndex](pa_context* context,
+                                                                                     PulseEngine::Completion done) {
+        if (restore) {
+            pa_operation* op = originalSink != PA_INVALID_INDEX
+                                   ? pa_context_move_sink_input_by_index(context, streamIndex, originalSink, nullptr, nullptr)
+                                   : pa_context_move_sink_input_by_name(context, streamIndex, "@DEFAULT_SINK@", nullptr, nullptr);
+            if (op) {
+                pa_operation_unref(op);
+            }
+        }
+        void* completion = PulseEngine::WrapCompletion(done);
+        PulseEngine::FinishIssue(pa_context_unload_module(context, moduleIndex, PulseEngine::SuccessCompletion, completion),
+                                 completion);
+    };
+
+    if (wait) {
+        if (insert->capture || insert->playback) {
+            AudioStreamLoop::Lock lock;
+            AudioStreamLoop::ReleaseStream(insert->capture);
+            AudioStreamLoop::ReleaseStream(insert->playback);
+            insert->capture = nullptr;
+            insert->playback = nullptr;
+        }
+        if (moduleIndex != PA_INVALID_INDEX) {
+            PulseEngine::Instance().RunAndWait(request);
+        }
+        return;
+    }
+
+    // Observer callbacks run on the engine thread, which must not wait for
+    // the stream loop lock. The streams are released on the loop, and the
+    // insert lives until then because their callbacks point at it.
+    if (moduleIndex != PA_INVALID_INDEX) {
+        PulseEngine::Instance().Post([request](pa_context* context) {
+            if (context) {
+                request(context, [](OperationResult) {});
+            }
+        });
+    }
+    if (insert->capture || insert->playback) {
+        std::shared_ptr<Insert> released(std::move(insert));
+        AudioStreamLoop::Instance().Post([released] {
+            AudioStreamLoop::ReleaseStream(released->capture);
+            AudioStreamLoop::ReleaseStream(released->playback);
+            released->capture = nullptr;
+            released->playback = nullptr;
+        });
+    }
+}
+
+void DspManager::OnSessionUpdated(const AudioSession& session, const AudioSession* previous) {
+    std::unique_ptr<Insert> abandoned;
+    {
+        std::lock_guard<std::mutex> lock(inserts_mutex_);
+        auto it = inserts_.find(session.handle);
+        if (it == inserts_.end()) {
+            return;
+        }
+
+        Insert* insert = it->second.get();
+        if (session.device_index == insert->sink_index) {
+            insert->routed = true;
+            return;
+        }
+        if (!insert->routed) {
+            return;
+        }
+
+        // Someone moved the stream elsewhere; leave it there
+        abandoned = std::move(it->second);
+        inserts_.erase(it);
+    }
+    Teardown(std::move(abandoned), false, false);
+}
+
+void DspManager::OnSessionRemoved(const AudioSession& session) {
+    std::vector<std::unique_ptr<Insert>> removed;
+    {
+        std::lock_guard<std::mutex> lock(inserts_mutex_);
+        if (GetHandleKind(session.handle) == SessionKind::Sink) {
+            // The device an insert plays to is gone, and its playback stream
+            // with it; route the application to the default device again
+            uint32_t sinkIndex = GetHandleIndex(session.handle);
+            for (auto it = inserts_.begin(); it != inserts_.end();) {
+                if (it->second->original_sink == sinkIndex) {
+                    it->second->original_sink = PA_INVALID_INDEX;
+                    removed.push_back(std::move(it->second));
+                    it = inserts_.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        } else {
+            auto it = inserts_.find(session.handle);
+            if (it != inserts_.end()) {
+                removed.push_back(std::move(it->second));
+                inserts_.erase(it);
+            }
+        }
+    }
+
+    // A removed application stream needs no route
+    bool restore = GetHandleKind(session.handle) == SessionKind::Sink;
+    for (auto& insert : removed) {
+        Teardown(std::move(insert), restore, false);
+    }
+}
+
+std::vector<DspStats> DspManager::GetStats() const {
+    std::lock_guard<std::mutex> lock(inserts_mutex_);
+
+    std::vector<DspStats> stats;
+    if (inserts_.empty()) {
+        return stats;
+    }
+
+    AudioStreamLoop::Lock loopLock;
+    for (const auto& entry : inserts_) {
+        const Insert* insert = entry.second.get();
+        DspStats item;
+        item.handle = insert->handle;
+        item.name = insert->name;
+        item.rate = insert->spec.rate;
+        item.channels = insert->spec.channels;
+        item.bands = insert->cascade.GetBandCount();
+        item.processed_frames = insert->processed_frames;
+        item.underflows = insert->underflows;
+        item.overflows = insert->overflows;
+
+        double audioNsec = insert->spec.rate ? insert->processed_frames * 1e9 / insert->spec.rate : 0.0;
+        item.cpu_load = audioNsec > 0.0 ? insert->cpu_nsec / audioNsec : 0.0;
+
+        item.latency_usec = 0;
+        pa_usec_t latency;
+        int negative;
+        if (pa_stream_get_latency(insert->capture, &latency, &negative) == 0 && !negative) {
+            item.latency_usec += latency;
+        }
+        if (pa_stream_get_latency(insert->playback, &latency, &negative) == 0 && !negative) {
+            item.latency_usec += latency;
+        }
+        stats.push_back(item);
+    }
+    return stats;
+}
+
+void DspManager::ReadCallback(pa_stream* stream, size_t nbytes, void* userdata) {
+    Insert* insert = static_cast<Insert*>(userdata);
+    size_t frameSize = pa_frame_size(&insert->spec);
+    uint64_t started = AudioStreamLoop::ThreadCpuNsec();
+
+    const void* data;
+    size_t length;
+    while (pa_stream_peek(stream, &data, &length) == 0 && length > 0) {
+        // Holes carry no data; the playback stream simply runs on
+        if (data && pa_stream_get_state(insert->playback) == PA_STREAM_READY) {
+            const float* input = static_cast<const float*>(data);
+            size_t frames = length / frameSize;
+
+            while (frames > 0) {
+                size_t chunk = std::min(frames, kScratchFrames);
+                size_t samples = chunk * insert->spec.channels;
+                std::copy(input, input + samples, insert->scratch.begin());
+                insert->cascade.Process(insert->scratch.data(), chunk);
+                pa_stream_write(insert->playback, insert->scratch.data(), samples * sizeof(float), nullptr, 0,
+                                PA_SEEK_RELATIVE);
+
+                insert->processed_frames += chunk;
+                input += samples;
+                frames -= chunk;
+            }
+        }
+        pa_stream_drop(stream);
+    }
+
+    insert->cpu_nsec += AudioStreamLoop::ThreadCpuNsec() - started;
+}
+
+void DspManager::UnderflowCallback(pa_stream* stream, void* userdata) {
+    static_cast<Insert*>(userdata)->underflows++;
+}
+
+void DspManager::OverflowCallback(pa_stream* stream, void* userdata) {
+    static_cast<Insert*>(userdata)->overflows++;
+}
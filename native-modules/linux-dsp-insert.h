@@ -0,0 +1,70 @@
+#pragma once
+
+#include "linux-audio-session.h"
+#include "linux-biquad-cascade.h"
+#include "linux-pulse-engine.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Per-insert figures reported to JS
+struct DspStats {
+    SessionHandle handle;
+    std::string name;
+    uint32_t rate;
+    uint32_t channels;
+    size_t bands;
+    uint64_t processed_frames;
+    double cpu_load;        // Processing CPU time / audio time processed
+    uint64_t latency_usec;  // Capture plus playback buffering added by the insert
+    uint32_t underflows;
+    uint32_t overflows;
+};
+
+// Opt-in equalizer inserted in front of an application stream.
+//
+// The stream is moved to a private null sink. A capture stream on that sink's
+// monitor feeds the biquad cascade on the stream loop thread, and a playback
+// stream carries the result to the device the application was using. Buffers
+// are sized for about 5 ms of capture and 10 ms of playback, which keeps the
+// added latency under 20 ms.
+class DspManager : public SessionObserver {
+public:
+    static DspManager& Instance();
+
+    // Insert the equalizer in front of a sink input. Returns false for other
+    // session kinds, invalid bands, or when the server refuses a step.
+    bool Enable(SessionHandle handle, const std::vector<BiquadBand>& bands);
+
+    // Replace the bands of a running insert
+    bool SetBands(SessionHandle handle, const std::vector<BiquadBand>& bands);
+
+    // Move the stream back to its device and remove the insert
+    bool Disable(SessionHandle handle);
+    void DisableAll();
+
+    std::vector<DspStats> GetStats() const;
+
+    void OnSessionUpdated(const AudioSession& session, const AudioSession* previous) override;
+    void OnSessionRemoved(const AudioSession& session) override;
+
+private:
+    struct Insert;
+
+    DspManager() = default;
+
+    std::unique_ptr<Insert> TakeInsert(SessionHandle handle);
+    static void Teardown(std::unique_ptr<Insert> insert, bool restore, bool wait);
+
+    static void ReadCallback(pa_stream* stream, size_t nbytes, void* userdata);
+    static void UnderflowCallback(pa_stream* stream, void* userdata);
+    static void OverflowCallback(pa_stream* stream, void* userdata);
+
+    // Serialises Enable/SetBands/Disable; the engine thread never takes it
+    std::mutex control_mutex_;
+
+    mutable std::mutex inserts_mutex_;
+    std::map<SessionHandle, std::unique_ptr<Insert>> inserts_;
+};
@@ -0,0 +1,532 @@
+#include "linux-event-trace.h"
+#include <pulse/timeval.h>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <limits>
+#include <unordered_map>
+
+const char kTraceMagic[8] = { 'A', 'M', 'P', 'T', 'R', 'A', 'C', 'E' };
+const size_t kTraceHeaderSize = sizeof(kTraceMagic) + 4 + 8;
+
+// Events applied per mainloop pass when replaying as fast as possible, so
+// posted tasks still get a turn
+const size_t kReplayBurst = 1024;
+
+// How long Stop waits for the engine thread to close the file
+const auto kRecorderStopTimeout = std::chrono::seconds(5);
+
+static uint64_t MonotonicUsec() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Append-only record encoder with string interning
+class EventTraceRecorder::Encoder {
+public:
+    void PutByte(uint8_t value) {
+        buffer_.push_back(static_cast<char>(value));
+    }
+
+    void PutVarint(uint64_t value) {
+        while (value >= 0x80) {
+            PutByte(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        PutByte(static_cast<uint8_t>(value));
+    }
+
+    void PutFloat(float value) {
+        char bytes[sizeof(float)];
+        std::memcpy(bytes, &value, sizeof(bytes));
+        buffer_.append(bytes, sizeof(bytes));
+    }
+
+    void PutString(const std::string& value) {
+        auto it = strings_.find(value);
+        if (it != strings_.end()) {
+            PutVarint(it->second);
+            return;
+        }
+
+        uint32_t id = static_cast<uint32_t>(strings_.size());
+        strings_.emplace(value, id);
+        PutVarint(id);
+        PutVarint(value.size());
+        buffer_.append(value);
+    }
+
+    // Write out the pending record; returns its size
+    size_t Flush(FILE* file) {
+        size_t size = buffer_.size();
+        fwrite(buffer_.data(), 1, size, file);
+        buffer_.clear();
+        return size;
+    }
+
+private:
+    std::string buffer_;
+    std::unordered_map<std::string, uint32_t> strings_;
+};
+
+// Bounds-checked decoder over a loaded trace
+class TraceDecoder {
+public:
+    TraceDecoder(const std::vector<char>& data, size_t offset) : data_(data), pos_(offset) {}
+
+    bool AtEnd() const { return pos_ >= data_.size(); }
+
+    bool GetByte(uint8_t* value) {
+        if (pos_ >= data_.size()) {
+            return false;
+        }
+        *value = static_cast<uint8_t>(data_[pos_++]);
+        return true;
+    }
+
+    bool GetVarint(uint64_t* value) {
+        *value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            uint8_t byte;
+            if (!GetByte(&byte)) {
+                return false;
+            }
+            *value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool GetVarint32(uint32_t* value) {
+        uint64_t wide;
+        if (!GetVarint(&wide) || wide > std::numeric_limits<uint32_t>::max()) {
+            return false;
+        }
+        *value = static_cast<uint32_t>(wide);
+        return true;
+    }
+
+    bool GetFloat(float* value) {
+        if (data_.size() - pos_ < sizeof(float)) {
+            return false;
+        }
+        std::memcpy(value, &data_[pos_], sizeof(float));
+        pos_ += sizeof(float);
+        return true;
+    }
+
+    bool GetString(std::string* value) {
+        uint64_t id;
+        if (!GetVarint(&id) || id > strings_.size()) {
+            return false;
+        }
+        if (id < strings_.size()) {
+            *value = strings_[id];
+            return true;
+        }
+
+        uint64_t length;
+        if (!GetVarint(&length) || length > data_.size() - pos_) {
+            return false;
+        }
+        strings_.emplace_back(&data_[pos_], length);
+        pos_ += length;
+        *value = strings_.back();
+        return true;
+    }
+
+private:
+    const std::vector<char>& data_;
+    size_t pos_;
+    std::vector<std::string> strings_;
+};
+
+static bool DecodeChannels(TraceDecoder* decoder, AudioSession* session) {
+    uint8_t channels;
+    if (!decoder->GetByte(&channels) || channels > PA_CHANNELS_MAX) {
+        return false;
+    }
+
+    // Positions are stored plus one so "invalid" encodes as 0
+    session->cvolume.channels = session->channel_map.channels = channels;
+    for (uint8_t i = 0; i < channels; i++) {
+        uint32_t position, volume;
+        if (!decoder->GetVarint32(&position) || !decoder->GetVarint32(&volume)) {
+            return false;
+        }
+        session->channel_map.map[i] = static_cast<pa_channel_position_t>(static_cast<int>(position) - 1);
+        session->cvolume.values[i] = volume;
+    }
+    return true;
+}
+
+static bool DecodeSession(TraceDecoder* decoder, uint32_t version, AudioSession* session) {
+    uint32_t kind, index, device, format, rate;
+    uint8_t channels, flags;
+
+    if (!decoder->GetVarint32(&kind) || !decoder->GetVarint32(&index) || !decoder->GetString(&session->name) ||
+        !decoder->GetFloat(&session->volume) || !decoder->GetByte(&flags) || !decoder->GetVarint32(&device) ||
+        !decoder->GetVarint32(&format) || !decoder->GetVarint32(&rate) || !decoder->GetByte(&channels) ||
+        !decoder->GetVarint(&session->buffer_usec) || !decoder->GetVarint(&session->device_usec) ||
+        !decoder->GetString(&session->resample_method) ||
+        (version >= 2 && !DecodeChannels(decoder, session))) {
+        return false;
+    }
+
+    session->handle = MakeSessionHandle(static_cast<SessionKind>(kind), index);
+    if (!IsValidSessionHandle(session->handle)) {
+        return false;
+    }
+    session->id = FormatSessionId(session->handle);
+    session->muted = (flags & 1) != 0;
+    session->corked = (flags & 2) != 0;
+
+    // Indices and formats are stored plus one so "invalid" encodes as 0
+    session->device_index = device == 0 ? PA_INVALID_INDEX : device - 1;
+    session->sample_spec.format = static_cast<pa_sample_format_t>(static_cast<int>(format) - 1);
+    session->sample_spec.rate = rate;
+    session->sample_spec.channels = channels;
+    return true;
+}
+
+bool ReadEventTrace(const std::string& path, std::vector<TraceEvent>* events, uint64_t* start_ms) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+
+    std::vector<char> data;
+    char chunk[65536];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        data.insert(data.end(), chunk, chunk + read);
+    }
+    fclose(file);
+
+    uint32_t version;
+    if (data.size() < kTraceHeaderSize || std::memcmp(data.data(), kTraceMagic, sizeof(kTraceMagic)) != 0) {
+        return false;
+    }
+    std::memcpy(&version, &data[sizeof(kTraceMagic)], sizeof(version));
+    if (version < 1 || version > kEventTraceVersion) {
+        return false;
+    }
+    if (start_ms) {
+        std::memcpy(start_ms, &data[sizeof(kTraceMagic) + 4], sizeof(*start_ms));
+    }
+
+    TraceDecoder decoder(data, kTraceHeaderSize);
+    uint64_t now = 0;
+    events->clear();
+
+    while (!decoder.AtEnd()) {
+        TraceEvent event = {};
+        uint8_t type;
+        uint64_t delta;
+        if (!decoder.GetByte(&type) || !decoder.GetVarint(&delta)) {
+            return false;
+        }
+        now += delta;
+        event.time_usec = now;
+        event.type = static_cast<TraceEventType>(type);
+
+        bool valid = false;
+        switch (event.type) {
+            case TraceEventType::Subscription: {
+                uint32_t eventType;
+                valid = decoder.GetVarint32(&eventType) && decoder.GetVarint32(&event.index);
+                event.event = static_cast<pa_subscription_event_type_t>(eventType);
+                break;
+            }
+            case TraceEventType::Update:
+                valid = DecodeSession(&decoder, version, &event.session);
+                break;
+            case TraceEventType::Removal: {
+                uint32_t kind, index;
+                valid = decoder.GetVarint32(&kind) && decoder.GetVarint32(&index);
+                event.handle = MakeSessionHandle(static_cast<SessionKind>(kind), index);
+                valid = valid && IsValidSessionHandle(event.handle);
+                break;
+            }
+            default:
+                break;
+        }
+        if (!valid) {
+            return false;
+        }
+        events->push_back(std::move(event));
+    }
+
+    return true;
+}
+
+EventTraceRecorder& EventTraceRecorder::Instance() {
+    static EventTraceRecorder recorder;
+    return recorder;
+}
+
+bool EventTraceRecorder::Start(const std::string& path) {
+    PulseEngine& engine = PulseEngine::Instance();
+    engine.Start();
+    if (!engine.IsRunning() || recording_.exchange(true)) {
+        return false;
+    }
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        recording_ = false;
+        return false;
+    }
+
+    uint32_t version = kEventTraceVersion;
+    uint64_t startMs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    fwrite(kTraceMagic, 1, sizeof(kTraceMagic), file);
+    fwrite(&version, 1, sizeof(version), file);
+    fwrite(&startMs, 1, sizeof(startMs), file);
+
+    engine.Post([this, file, &engine](pa_context* context) {
+        file_ = file;
+        encoder_.reset(new Encoder());
+        started_usec_ = last_usec_ = MonotonicUsec();
+        events_ = 0;
+        active_ = true;
+
+        // Start from the table as it stands, so a replay begins complete
+        for (const AudioSession& session : engine.GetSessions()) {
+            BeginRecord(TraceEventType::Update);
+            WriteSession(session);
+            encoder_->Flush(file_);
+        }
+    });
+    return true;
+}
+
+bool EventTraceRecorder::Stop(Summary* summary) {
+    if (!recording_) {
+        return false;
+    }
+
+    auto finished = std::make_shared<std::promise<Summary>>();
+    std::future<Summary> result = finished->get_future();
+    PulseEngine::Instance().Post([this, finished](pa_context* context) {
+        Summary done = {};
+        if (active_) {
+            done.events = events_;
+            done.bytes = static_cast<uint64_t>(ftell(file_));
+            done.duration_usec = last_usec_ - started_usec_;
+            Finish();
+        }
+        // Cleared here rather than by the caller, so a Start() after a timed
+        // out Stop() cannot open a second file while this one is still active
+        recording_ = false;
+        finished->set_value(done);
+    });
+
+    bool stopped = result.wait_for(kRecorderStopTimeout) == std::future_status::ready;
+    if (stopped && summary) {
+        *summary = result.get();
+    }
+    return stopped;
+}
+
+void EventTraceRecorder::Finish() {
+    active_ = false;
+    fclose(file_);
+    file_ = nullptr;
+    encoder_.reset();
+}
+
+void EventTraceRecorder::BeginRecord(TraceEventType type) {
+    uint64_t now = MonotonicUsec();
+    encoder_->PutByte(static_cast<uint8_t>(type));
+    encoder_->PutVarint(now - last_usec_);
+    last_usec_ = now;
+    events_++;
+}
+
+void EventTraceRecorder::WriteSession(const AudioSession& session) {
+    encoder_->PutVarint(static_cast<uint32_t>(GetHandleKind(session.handle)));
+    encoder_->PutVarint(GetHandleIndex(session.handle));
+    encoder_->PutString(session.name);
+    encoder_->PutFloat(session.volume);
+    encoder_->PutByte((session.muted ? 1 : 0) | (session.corked ? 2 : 0));
+    encoder_->PutVarint(session.device_index == PA_INVALID_INDEX ? 0 : session.device_index + 1ull);
+    encoder_->PutVarint(static_cast<uint32_t>(static_cast<int>(session.sample_spec.format) + 1));
+    encoder_->PutVarint(session.sample_spec.rate);
+    encoder_->PutByte(session.sample_spec.channels);
+    encoder_->PutVarint(session.buffer_usec);
+    encoder_->PutVarint(session.device_usec);
+    encoder_->PutString(session.resample_method);
+
+    encoder_->PutByte(session.cvolume.channels);
+    for (uint8_t i = 0; i < session.cvolume.channels; i++) {
+        encoder_->PutVarint(static_cast<uint32_t>(static_cast<int>(session.channel_map.map[i]) + 1));
+        encoder_->PutVarint(session.cvolume.values[i]);
+    }
+}
+
+void EventTraceRecorder::OnSessionUpdated(const AudioSession& session, const AudioSession* previous) {
+    if (!active_) {
+        return;
+    }
+    BeginRecord(TraceEventType::Update);
+    WriteSession(session);
+    encoder_->Flush(file_);
+}
+
+void EventTraceRecorder::OnSessionRemoved(const AudioSession& session) {
+    if (!active_) {
+        return;
+    }
+    BeginRecord(TraceEventType::Removal);
+    encoder_->PutVarint(static_cast<uint32_t>(GetHandleKind(session.handle)));
+    encoder_->PutVarint(GetHandleIndex(session.handle));
+    encoder_->Flush(file_);
+}
+
+void EventTraceRecorder::OnSubscriptionEvent(pa_subscription_event_type_t type, uint32_t index) {
+    if (!active_) {
+        return;
+    }
+    BeginRecord(TraceEventType::Subscription);
+    encoder_->PutVarint(static_cast<uint32_t>(type));
+    encoder_->PutVarint(index);
+    encoder_->Flush(file_);
+}
+
+EventTraceReplayer& EventTraceReplayer::Instance() {
+    static EventTraceReplayer replayer;
+    return replayer;
+}
+
+bool EventTraceReplayer::Start(const std::string& path, double speed) {
+    if (active_ || !(speed >= 0.0)) {
+        return false;
+    }
+
+    std::vector<TraceEvent> events;
+    if (!ReadEventTrace(path, &events, nullptr)) {
+        return false;
+    }
+
+    PulseEngine& engine = PulseEngine::Instance();
+    engine.Start();
+    if (!engine.IsRunning()) {
+        return false;
+    }
+
+    speed_ = speed;
+    total_ = events.size();
+    applied_ = 0;
+    trace_usec_ = 0;
+    finished_ = false;
+    active_ = true;
+
+    // The mode switch empties the table first; the replay starts after it
+    engine.SetReplayMode(true);
+    auto loaded = std::make_shared<std::vector<TraceEvent>>(std::move(events));
+    engine.Post([this, loaded](pa_context* context) {
+        events_ = std::move(*loaded);
+        Begin();
+    });
+    return true;
+}
+
+void EventTraceReplayer::Stop() {
+    if (!active_) {
+        return;
+    }
+
+    PulseEngine& engine = PulseEngine::Instance();
+    engine.Post([this](pa_context* context) {
+        Cancel();
+        events_.clear();
+        events_.shrink_to_fit();
+    });
+    engine.SetReplayMode(false);
+    active_ = false;
+}
+
+EventTraceReplayer::Status EventTraceReplayer::GetStatus() const {
+    Status status;
+    status.active = active_;
+    status.finished = finished_;
+    status.speed = speed_;
+    status.applied = applied_;
+    status.total = total_;
+    status.trace_usec = trace_usec_;
+
+    uint64_t end = finished_ ? finished_usec_.load() : MonotonicUsec();
+    status.elapsed_usec = active_ && started_usec_ ? end - started_usec_ : 0;
+    return status;
+}
+
+void EventTraceReplayer::Begin() {
+    next_ = 0;
+    started_usec_ = MonotonicUsec();
+    ApplyDue();
+}
+
+void EventTraceReplayer::ApplyDue() {
+    PulseEngine& engine = PulseEngine::Instance();
+
+    // Trace time the wall clock has reached at this speed
+    uint64_t due = std::numeric_limits<uint64_t>::max();
+    size_t budget = kReplayBurst;
+    if (speed_ > 0.0) {
+        due = static_cast<uint64_t>((MonotonicUsec() - started_usec_) * speed_);
+        budget = std::numeric_limits<size_t>::max();
+    }
+
+    // Subscription records only mark when the server spoke; their results
+    // follow as updates and removals
+    while (next_ < events_.size() && events_[next_].time_usec <= due && budget-- > 0) {
+        const TraceEvent& event = events_[next_++];
+        if (event.type == TraceEventType::Update) {
+            engine.ApplySessionUpdate(event.session);
+        } else if (event.type == TraceEventType::Removal) {
+            engine.ApplySessionRemoval(event.handle);
+        }
+        trace_usec_ = event.time_usec;
+        applied_++;
+    }
+
+    if (next_ >= events_.size()) {
+        Cancel();
+        finished_usec_ = MonotonicUsec();
+        finished_ = true;
+        return;
+    }
+
+    uint64_t delay = 0;
+    if (speed_ > 0.0 && events_[next_].time_usec > due) {
+        delay = static_cast<uint64_t>((events_[next_].time_usec - due) / speed_);
+    }
+    Schedule(delay);
+}
+
+void EventTraceReplayer::Schedule(uint64_t delay_usec) {
+    pa_mainloop_api* api = PulseEngine::Instance().GetMainloopApi();
+    struct timeval tv;
+    pa_timeval_add(pa_gettimeofday(&tv), delay_usec);
+
+    if (timer_) {
+        api->time_restart(timer_, &tv);
+    } else {
+        timer_ = api->time_new(api, &tv, TimerCallback, this);
+    }
+}
+
+void EventTraceReplayer::Cancel() {
+    if (timer_) {
+        PulseEngine::Instance().GetMainloopApi()->time_free(timer_);
+        timer_ = nullptr;
+    }
+}
+
+void EventTraceReplayer::TimerCallback(pa_mainloop_api* api, pa_time_event* event, const struct timeval* tv, void* userdata) {
+    static_cast<EventTraceReplayer*>(userdata)->ApplyDue();
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "linux-audio-session.h"
+#include "linux-pulse-engine.h"
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Binary trace of what the engine received from the server.
+//
+// A trace file starts with the 8-byte magic "AMPTRACE", a little-endian
+// uint32 version and the uint64 wall-clock start time in milliseconds. Each
+// record that follows is a type byte, the time since the previous record in
+// microseconds (LEB128 varint) and the payload:
+//   subscription  event type, object index
+//   update        the session record built from an introspection result
+//   removal       session kind, object index
+// Integers are varints and floats raw little-endian. Strings are interned:
+// a varint id, followed by the bytes only the first time the id is used.
+// The first records of a trace are updates for the table as it stood when
+// recording started. Version 2 appends the channel count, positions and
+// per-channel volumes to each session record; version 1 traces still load.
+
+const uint32_t kEventTraceVersion = 2;
+
+enum class TraceEventType : uint8_t {
+    Subscription = 1,
+    Update = 2,
+    Removal = 3
+};
+
+struct TraceEvent {
+    TraceEventType type;
+    uint64_t time_usec;  // Since the start of the trace
+    pa_subscription_event_type_t event;  // Subscription
+    uint32_t index;                      // Subscription
+    SessionHandle handle;                // Removal
+    AudioSession session;                // Update
+};
+
+// Load a whole trace. Returns false if the file is missing, of an unknown
+// version, or truncated or corrupt anywhere.
+bool ReadEventTrace(const std::string& path, std::vector<TraceEvent>* events, uint64_t* start_ms);
+
+// Records table updates, removals and subscription events to a trace file.
+// Records are written on the engine thread through a buffered stream.
+class EventTraceRecorder : public SessionObserver, public SubscriptionListener {
+public:
+    struct Summary {
+        uint64_t events;
+        uint64_t bytes;
+        uint64_t duration_usec;
+    };
+
+    static EventTraceRecorder& Instance();
+
+    // Open the file and start recording with a snapshot of the current table
+    bool Start(const std::string& path);
+
+    // Finish the file; returns false if nothing was being recorded
+    bool Stop(Summary* summary);
+
+    bool IsRecording() const { return recording_; }
+
+    void OnSessionUpdated(const AudioSession& session, const AudioSession* previous) override;
+    void OnSessionRemoved(const AudioSession& session) override;
+    void OnSubscriptionEvent(pa_subscription_event_type_t type, uint32_t index) override;
+
+private:
+    class Encoder;
+
+    EventTraceRecorder() = default;
+
+    void BeginRecord(TraceEventType type);
+    void WriteSession(const AudioSession& session);
+    void Finish();
+
+    std::atomic<bool> recording_{false};
+
+    // Engine thread while recording
+    FILE* file_ = nullptr;
+    std::unique_ptr<Encoder> encoder_;
+    bool active_ = false;
+    uint64_t started_usec_ = 0;
+    uint64_t last_usec_ = 0;
+    uint64_t events_ = 0;
+};
+
+// Feeds a trace back through PulseEngine::ApplySessionUpdate and
+// ApplySessionRemoval on the engine thread, so observers, change batches and
+// the N-API layer see the same calls as with a live server. Runs at the
+// recorded pace times a speed factor, or as fast as possible with speed 0.
+class EventTraceReplayer {
+public:
+    struct Status {
+        bool active;
+        bool finished;
+        double speed;
+        uint64_t applied;
+        uint64_t total;
+        uint64_t trace_usec;    // Trace time reached
+        uint64_t elapsed_usec;  // Wall time since the replay started
+    };
+
+    static EventTraceReplayer& Instance();
+
+    // Load a trace and start replaying it; the engine leaves the server
+    bool Start(const std::string& path, double speed);
+
+    // Stop replaying and reconnect the engine to the server
+    void Stop();
+
+    Status GetStatus() const;
+
+private:
+    EventTraceReplayer() = default;
+
+    void Begin();
+    void ApplyDue();
+    void Schedule(uint64_t delay_usec);
+    void Cancel();
+    static void TimerCallback(pa_mainloop_api* api, pa_time_event* event, const struct timeval* tv, void* userdata);
+
+    std::atomic<bool> active_{false};
+    std::atomic<bool> finished_{false};
+    std::atomic<uint64_t> applied_{0};
+    std::atomic<uint64_t> trace_usec_{0};
+    std::atomic<uint64_t> started_usec_{0};
+    std::atomic<uint64_t> finished_usec_{0};
+    double speed_ = 1.0;
+    uint64_t total_ = 0;
+
+    // Engine thread while replaying
+    std::vector<TraceEvent> events_;
+    size_t next_ = 0;
+    pa_time_event* timer_ = nullptr;
+};
@@ -0,0 +1,121 @@
+#include "linux-fft.h"
+#include "linux-simd.h"
+#include <cmath>
+
+bool RealFft::IsValidSize(size_t size) {
+    return size >= kMinSize && size <= kMaxSize && (size & (size - 1)) == 0;
+}
+
+RealFft::RealFft(size_t size) : size_(size), half_(size / 2) {
+    // Hann window; the coherent gain (sum / 2) normalises a sine to 1.0
+    window_.resize(size_);
+    double windowSum = 0.0;
+    for (size_t n = 0; n < size_; n++) {
+        window_[n] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * M_PI * n / size_));
+        windowSum += window_[n];
+    }
+    scale_ = static_cast<float>(2.0 / windowSum);
+
+    unsigned bits = 0;
+    while ((static_cast<size_t>(1) << bits) < half_) {
+        bits++;
+    }
+    bit_reverse_.resize(half_);
+    for (size_t i = 0; i < half_; i++) {
+        uint32_t reversed = 0;
+        for (unsigned b = 0; b < bits; b++) {
+            if (i & (static_cast<size_t>(1) << b)) {
+                reversed |= 1u << (bits - 1 - b);
+            }
+        }
+        bit_reverse_[i] = reversed;
+    }
+
+    for (size_t span = 1; span < half_; span *= 2) {
+        for (size_t k = 0; k < span; k++) {
+            double angle = -M_PI * k / span;
+            twiddle_re_.push_back(static_cast<float>(std::cos(angle)));
+            twiddle_im_.push_back(static_cast<float>(std::sin(angle)));
+        }
+    }
+
+    split_re_.resize(half_ + 1);
+    split_im_.resize(half_ + 1);
+    for (size_t k = 0; k <= half_; k++) {
+        double angle = -2.0 * M_PI * k / size_;
+        split_re_[k] = static_cast<float>(std::cos(angle));
+        split_im_[k] = static_cast<float>(std::sin(angle));
+    }
+
+    re_.resize(half_);
+    im_.resize(half_);
+}
+
+void RealFft::Transform(const float* input, float* magnitudes) {
+    float* re = re_.data();
+    float* im = im_.data();
+
+    // Window and pack even/odd samples into bit-reversed complex slots
+    for (size_t i = 0; i < half_; i++) {
+        uint32_t target = bit_reverse_[i];
+        re[target] = input[2 * i] * window_[2 * i];
+        im[target] = input[2 * i + 1] * window_[2 * i + 1];
+    }
+
+    const float* twiddleRe = twiddle_re_.data();
+    const float* twiddleIm = twiddle_im_.data();
+    for (size_t span = 1; span < half_; span *= 2) {
+        for (size_t start = 0; start < half_; start += 2 * span) {
+            float* aRe = re + start;
+            float* aIm = im + start;
+            float* bRe = aRe + span;
+            float* bIm = aIm + span;
+            size_t k = 0;
+
+            if (span >= 4) {
+                for (; k < span; k += 4) {
+                    Float4 wr = LoadFloat4(twiddleRe + k);
+                    Float4 wi = LoadFloat4(twiddleIm + k);
+                    Float4 xr = LoadFloat4(bRe + k);
+                    Float4 xi = LoadFloat4(bIm + k);
+                    Float4 tr = xr * wr - xi * wi;
+                    Float4 ti = xr * wi + xi * wr;
+                    Float4 ur = LoadFloat4(aRe + k);
+                    Float4 ui = LoadFloat4(aIm + k);
+                    StoreFloat4(aRe + k, ur + tr);
+                    StoreFloat4(aIm + k, ui + ti);
+                    StoreFloat4(bRe + k, ur - tr);
+                    StoreFloat4(bIm + k, ui - ti);
+                }
+            }
+            for (; k < span; k++) {
+                float tr = bRe[k] * twiddleRe[k] - bIm[k] * twiddleIm[k];
+                float ti = bRe[k] * twiddleIm[k] + bIm[k] * twiddleRe[k];
+                bRe[k] = aRe[k] - tr;
+                bIm[k] = aIm[k] - ti;
+                aRe[k] += tr;
+                aIm[k] += ti;
+            }
+        }
+        twiddleRe += span;
+        twiddleIm += span;
+    }
+
+    // Separate the packed transform: X[k] = E[k] + W^k O[k], with E and O the
+    // transforms of the even and odd samples
+    for (size_t k = 0; k <= half_; k++) {
+        size_t a = k % half_;
+        size_t b = (half_ - k) % half_;
+        float zr = re[a], zi = im[a];
+        float cr = re[b], ci = -im[b];
+
+        float evenRe = 0.5f * (zr + cr);
+        float evenIm = 0.5f * (zi + ci);
+        float oddRe = 0.5f * (zi - ci);
+        float oddIm = -0.5f * (zr - cr);
+
+        float xr = evenRe + split_re_[k] * oddRe - split_im_[k] * oddIm;
+        float xi = evenIm + split_re_[k] * oddIm + split_im_[k] * oddRe;
+        magnitudes[k] = std::sqrt(xr * xr + xi * xi) * scale_;
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Windowed real FFT with a precomputed plan.
+//
+// A real input of N samples is packed into an N/2-point complex FFT (even
+// samples as real parts, odd as imaginary) and separated afterwards. The
+// complex FFT is an iterative radix-2 transform on split real/imaginary
+// arrays, so every butterfly stage from span 4 upwards runs on Float4 lanes.
+// Twiddles, the bit-reversal permutation, the Hann window and all work
+// buffers are built once per size; Transform does not allocate.
+class RealFft {
+public:
+    // size must be a power of two between kMinSize and kMaxSize
+    explicit RealFft(size_t size);
+
+    static const size_t kMinSize = 64;
+    static const size_t kMaxSize = 16384;
+    static bool IsValidSize(size_t size);
+
+    size_t GetSize() const { return size_; }
+
+    // Window `size` samples and write size/2 + 1 magnitudes, scaled so a
+    // full-scale sine reads 1.0 in its bin
+    void Transform(const float* input, float* magnitudes);
+
+private:
+    size_t size_;
+    size_t half_;
+    float scale_;
+
+    std::vector<float> window_;
+    std::vector<uint32_t> bit_reverse_;
+
+    // Twiddles for every stage, stage after stage (span 1, 2, 4...)
+    std::vector<float> twiddle_re_;
+    std::vector<float> twiddle_im_;
+
+    // e^(-2*pi*i*k/size) for separating the packed real transform
+    std::vector<float> split_re_;
+    std::vector<float> split_im_;
+
+    std::vector<float> re_;
+    std::vector<float> im_;
+};
@@ -0,0 +1,62 @@
+#include "linux-mute-rules.h"
+#include "linux-session-operations.h"
+
+MuteRuleEnforcer& MuteRuleEnforcer::Instance() {
+    static MuteRuleEnforcer enforcer;
+    return enforcer;
+}
+
+void MuteRuleEnforcer::SetRules(std::map<std::string, bool> rules) {
+    std::lock_guard<std::mutex> lock(rules_mutex_);
+    rules_ = std::move(rules);
+}
+
+void MuteRuleEnforcer::SetRule(const std::string& name, bool muted) {
+    std::lock_guard<std::mutex> lock(rules_mutex_);
+    rules_[name] = muted;
+}
+
+void MuteRuleEnforcer::OnSessionUpdated(const AudioSession& session, const AudioSession* previous) {
+    if (!AppliesTo(GetHandleKind(session.handle))) {
+        return;
+    }
+
+    bool muted;
+    {
+        std::lock_guard<std::mutex> lock(rules_mutex_);
+        auto rule = rules_.find(session.name);
+        if (rule == rules_.end()) {
+            return;
+        }
+        muted = rule->second;
+    }
+
+    if (session.muted == muted) {
+        pending_.erase(session.handle);
+        return;
+    }
+    if (!pending_.insert(session.handle).second) {
+        return;
+    }
+
+    // Issue the correction once the current callback has returned
+    SessionHandle handle = session.handle;
+    PulseEngine::Instance().Post([this, handle, muted](pa_context* context) {
+        if (!context) {
+            pending_.erase(handle);
+            return;
+        }
+
+        // A refused correction may be retried on the next update
+        enforcements_++;
+        MuteRequest(handle, muted)(context, [this, handle](OperationResult result) {
+            if (!result.success) {
+                pending_.erase(handle);
+            }
+        });
+    });
+}
+
+void MuteRuleEnforcer::OnSessionRemoved(const AudioSession& session) {
+    pending_.erase(session.handle);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "linux-audio-session.h"
+#include "linux-pulse-engine.h"
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+// Keeps playback sessions at the mute state the user saved for their name.
+// Runs on the engine thread in every activity mode, so a newly started
+// application is corrected before any UI sees it.
+class MuteRuleEnforcer : public SessionObserver {
+public:
+    static MuteRuleEnforcer& Instance();
+
+    // Replace the rules (any thread): session name -> muted
+    void SetRules(std::map<std::string, bool> rules);
+
+    // Add or change the rule for one name (any thread)
+    void SetRule(const std::string& name, bool muted);
+
+    // Saved states belong to playback (sinks and sink inputs); a capture
+    // stream shares its application's name but keeps its own mute state
+    static bool AppliesTo(SessionKind kind) {
+        return kind != SessionKind::Source && kind != SessionKind::SourceOutput;
+    }
+
+    uint64_t GetEnforcementCount() const { return enforcements_; }
+
+    void OnSessionUpdated(const AudioSession& session, const AudioSession* previous) override;
+    void OnSessionRemoved(const AudioSession& session) override;
+
+private:
+    MuteRuleEnforcer() = default;
+
+    std::mutex rules_mutex_;
+    std::map<std::string, bool> rules_;
+
+    // Sessions with a correction in flight (engine thread)
+    std::set<SessionHandle> pending_;
+    std::atomic<uint64_t> enforcements_{0};
+};
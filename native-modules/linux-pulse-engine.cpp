@@ -0,0 +1,739 @@
+#include "linux-pulse-engine.h"
+#include <pulse/timeval.h>
+#include <poll.h>
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <memory>
+
+// Maximum time Start() waits for the first enumeration
+const auto kStartTimeout = std::chrono::seconds(5);
+
+// Maximum time RunAndWait() waits for the server to answer
+const auto kOperationTimeout = std::chrono::seconds(5);
+
+// Delay before reconnecting after the server went away
+const pa_usec_t kReconnectDelay = 2 * PA_USEC_PER_SEC;
+
+// Events followed in each activity mode. Suspended keeps stream arrivals so
+// mute rules still apply to new applications; the mask cannot select event
+// types, so SubscribeCallback drops the stream changes it also delivers.
+static pa_subscription_mask_t SubscriptionMaskFor(ActivityMode mode) {
+    if (mode == ActivityMode::Suspended) {
+        return static_cast<pa_subscription_mask_t>(PA_SUBSCRIPTION_MASK_SINK_INPUT | PA_SUBSCRIPTION_MASK_SOURCE_OUTPUT);
+    }
+    return static_cast<pa_subscription_mask_t>(PA_SUBSCRIPTION_MASK_SINK | PA_SUBSCRIPTION_MASK_SINK_INPUT |
+                                               PA_SUBSCRIPTION_MASK_SOURCE | PA_SUBSCRIPTION_MASK_SOURCE_OUTPUT);
+}
+
+PulseEngine& PulseEngine::Instance() {
+    static PulseEngine engine;
+    return engine;
+}
+
+PulseEngine::~PulseEngine() {
+    Stop();
+}
+
+bool PulseEngine::Start() {
+    std::unique_lock<std::mutex> lock(start_mutex_);
+
+    if (!started_) {
+        mainloop_ = pa_mainloop_new();
+        if (!mainloop_) {
+            return false;
+        }
+        mainloop_api_ = pa_mainloop_get_api(mainloop_);
+        pa_mainloop_set_poll_func(mainloop_, PollCallback, this);
+        stopping_ = false;
+        started_ = true;
+        thread_ = std::thread(&PulseEngine::Run, this);
+
+        // Only the first caller waits; later calls report the current state so a
+        // missing server does not stall every poll
+        start_cv_.wait_for(lock, kStartTimeout, [this]() { return first_sync_done_; });
+    }
+
+    return ready_;
+}
+
+bool PulseEngine::IsRunning() {
+    std::lock_guard<std::mutex> lock(start_mutex_);
+    return started_;
+}
+
+void PulseEngine::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(start_mutex_);
+        if (!started_) {
+            return;
+        }
+        started_ = false;
+    }
+
+    stopping_ = true;
+    pa_mainloop_wakeup(mainloop_);
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    // A later Start() waits for its own first enumeration; reset only once the
+    // old thread can no longer set it
+    {
+        std::lock_guard<std::mutex> lock(start_mutex_);
+        first_sync_done_ = false;
+    }
+
+    pa_mainloop_free(mainloop_);
+    mainloop_ = nullptr;
+    mainloop_api_ = nullptr;
+    replaying_ = false;
+}
+
+int PulseEngine::PollCallback(struct pollfd* fds, unsigned long count, int timeout, void* userdata) {
+    int result = poll(fds, count, timeout);
+    static_cast<PulseEngine*>(userdata)->wakeups_++;
+    return result;
+}
+
+void PulseEngine::Run() {
+    if (!replaying_) {
+        Connect();
+    }
+
+    while (!stopping_) {
+        if (pa_mainloop_iterate(mainloop_, 1, nullptr) < 0) {
+            break;
+        }
+        RunPostedTasks();
+    }
+
+    Disconnect();
+    ready_ = false;
+    ClearSessions();
+    RunPostedTasks();
+
+    std::lock_guard<std::mutex> lock(observers_mutex_);
+    for (ActivityListener* listener : activity_listeners_) {
+        listener->OnEngineStopping();
+    }
+}
+
+void PulseEngine::Connect() {
+    // Listings in flight on an old context never finish
+    pending_enumerations_ = 0;
+    enumerate_again_ = false;
+
+    context_ = pa_context_new(mainloop_api_, "AmpCore");
+    if (!context_) {
+        ScheduleReconnect();
+        return;
+    }
+
+    pa_context_set_state_callback(context_, ContextStateCallback, this);
+    if (pa_context_connect(context_, NULL, PA_CONTEXT_NOFLAGS, NULL) < 0) {
+        ScheduleReconnect();
+    }
+}
+
+void PulseEngine::Disconnect() {
+    if (reconnect_event_) {
+        mainloop_api_->time_free(reconnect_event_);
+        reconnect_event_ = nullptr;
+    }
+    if (context_) {
+        FailBatches();
+        pa_context_set_subscribe_callback(context_, nullptr, nullptr);
+        pa_context_set_state_callback(context_, nullptr, nullptr);
+        pa_context_disconnect(context_);
+        pa_context_unref(context_);
+        context_ = nullptr;
+    }
+}
+
+void PulseEngine::ScheduleReconnect() {
+    if (stopping_ || replaying_ || reconnect_event_) {
+        return;
+    }
+
+    struct timeval tv;
+    pa_timeval_add(pa_gettimeofday(&tv), kReconnectDelay);
+    reconnect_event_ = mainloop_api_->time_new(mainloop_api_, &tv, ReconnectCallback, this);
+}
+
+void PulseEngine::ReconnectCallback(pa_mainloop_api* api, pa_time_event* event, const struct timeval* tv, void* userdata) {
+    PulseEngine* engine = static_cast<PulseEngine*>(userdata);
+
+    api->time_free(event);
+    engine->reconnect_event_ = nullptr;
+
+    if (engine->context_) {
+        pa_context_set_state_callback(engine->context_, nullptr, nullptr);
+        pa_context_unref(engine->context_);
+        engine->context_ = nullptr;
+    }
+    engine->Connect();
+}
+
+void PulseEngine::Post(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex_);
+        tasks_.push_back(std::move(task));
+    }
+
+    std::lock_guard<std::mutex> lock(start_mutex_);
+    if (started_) {
+        pa_mainloop_wakeup(mainloop_);
+    }
+}
+
+void PulseEngine::RunPostedTasks() {
+    std::vector<Task> tasks;
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex_);
+        tasks.swap(tasks_);
+    }
+
+    pa_context* context = ready_ ? context_ : nullptr;
+    for (auto& task : tasks) {
+        task(context);
+    }
+}
+
+void PulseEngine::Enumerate() {
+    pa_operation* op;
+
+    // A second pass must not reset the one in flight, or its remaining
+    // callbacks would end the new pass early; run it once this one is done
+    if (pending_enumerations_ > 0) {
+        enumerate_again_ = true;
+        return;
+    }
+
+    enumerated_.clear();
+    pending_enumerations_ = 0;
+    if ((op = pa_context_get_sink_info_list(context_, SinkListCallback, this))) {
+        pending_enumerations_++;
+        pa_operation_unref(op);
+    }
+    if ((op = pa_context_get_sink_input_info_list(context_, SinkInputListCallback, this))) {
+        pending_enumerations_++;
+        pa_operation_unref(op);
+    }
+    if ((op = pa_context_get_source_info_list(context_, SourceListCallback, this))) {
+        pending_enumerations_++;
+        pa_operation_unref(op);
+    }
+    if ((op = pa_context_get_source_output_info_list(context_, SourceOutputListCallback, this))) {
+        pending_enumerations_++;
+        pa_operation_unref(op);
+    }
+    if (pending_enumerations_ == 0) {
+        pending_enumerations_ = 1;
+        EnumerationFinished();
+    }
+}
+
+void PulseEngine::EnumerationFinished() {
+    if (--pending_enumerations_ > 0) {
+        return;
+    }
+
+    // Drop whatever disappeared while events were not being followed
+    std::vector<SessionHandle> stale;
+    {
+        std::lock_guard<std::mutex> lock(table_mutex_);
+        for (const auto& entry : sessions_) {
+            if (enumerated_.count(entry.first) == 0) {
+                stale.push_back(entry.first);
+            }
+        }
+    }
+    for (SessionHandle handle : stale) {
+        ApplySessionRemoval(handle);
+    }
+    enumerated_.clear();
+
+    ready_ = true;
+    {
+        std::lock_guard<std::mutex> lock(start_mutex_);
+        first_sync_done_ = true;
+        start_cv_.notify_all();
+    }
+
+    if (enumerate_again_) {
+        enumerate_again_ = false;
+        Enumerate();
+    }
+}
+
+void PulseEngine::ContextStateCallback(pa_context* context, void* userdata) {
+    PulseEngine* engine = static_cast<PulseEngine*>(userdata);
+
+    switch (pa_context_get_state(context)) {
+        case PA_CONTEXT_READY: {
+            pa_context_set_subscribe_callback(context, SubscribeCallback, engine);
+
+            // Subscribe first so no change between the listing and the
+            // subscription is lost, then list everything in one round trip
+            engine->applied_mode_ = engine->mode_;
+            pa_operation* op = pa_context_subscribe(context, SubscriptionMaskFor(engine->applied_mode_), nullptr, nullptr);
+            if (op) {
+                pa_operation_unref(op);
+            }
+
+            engine->Enumerate();
+            break;
+        }
+        case PA_CONTEXT_FAILED:
+        case PA_CONTEXT_TERMINATED: {
+            engine->ready_ = false;
+            engine->FailBatches();
+            engine->ClearSessions();
+
+            // Wake a waiting Start() so it does not sit out the full timeout
+            {
+                std::lock_guard<std::mutex> lock(engine->start_mutex_);
+                engine->first_sync_done_ = true;
+                engine->start_cv_.notify_all();
+            }
+
+            engine->ScheduleReconnect();
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void PulseEngine::SubscribeCallback(pa_context* context, pa_subscription_event_type_t type, uint32_t index, void* userdata) {
+    PulseEngine* engine = static_cast<PulseEngine*>(userdata);
+    {
+        std::lock_guard<std::mutex> lock(engine->observers_mutex_);
+        for (SubscriptionListener* listener : engine->subscription_listeners_) {
+            listener->OnSubscriptionEvent(type, index);
+        }
+    }
+
+    unsigned facility = type & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+    unsigned kind = type & PA_SUBSCRIPTION_EVENT_TYPE_MASK;
+    bool removed = kind == PA_SUBSCRIPTION_EVENT_REMOVE;
+    pa_operation* op = nullptr;
+
+    // Only arrivals and departures matter while suspended; a volume animation
+    // in another application must not cost a round trip per step. Leaving
+    // Suspended re-enumerates, which picks up the changes skipped here.
+    if (engine->applied_mode_ == ActivityMode::Suspended && kind == PA_SUBSCRIPTION_EVENT_CHANGE) {
+        return;
+    }
+
+    switch (facility) {
+        case PA_SUBSCRIPTION_EVENT_SINK:
+            if (removed) {
+                engine->ApplySessionRemoval(MakeSessionHandle(SessionKind::Sink, index));
+            } else {
+                op = pa_context_get_sink_info_by_index(context, index, SinkCallback, engine);
+            }
+            break;
+        case PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+            if (removed) {
+                engine->ApplySessionRemoval(MakeSessionHandle(SessionKind::SinkInput, index));
+            } else {
+                op = pa_context_get_sink_input_info(context, index, SinkInputCallback, engine);
+            }
+            break;
+        case PA_SUBSCRIPTION_EVENT_SOURCE:
+            if (removed) {
+                engine->ApplySessionRemoval(MakeSessionHandle(SessionKind::Source, index));
+            } else {
+                op = pa_context_get_source_info_by_index(context, index, SourceCallback, engine);
+            }
+            break;
+        case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT:
+            if (removed) {
+                engine->ApplySessionRemoval(MakeSessionHandle(SessionKind::SourceOutput, index));
+            } else {
+                op = pa_context_get_source_output_info(context, index, SourceOutputCallback, engine);
+            }
+            break;
+        default:
+            break;
+    }
+
+    if (op) {
+        pa_operation_unref(op);
+    }
+}
+
+void PulseEngine::SinkCallback(pa_context* context, const pa_sink_info* info, int eol, void* userdata) {
+    if (eol == 0 && info && !IsInternalSink(info)) {
+        static_cast<PulseEngine*>(userdata)->ApplySessionUpdate(MakeSinkSession(info));
+    }
+}
+
+void PulseEngine::SinkListCallback(pa_context* context, const pa_sink_info* info, int eol, void* userdata) {
+    PulseEngine* engine = static_cast<PulseEngine*>(userdata);
+    if (eol != 0) {
+        engine->EnumerationFinished();
+        return;
+    }
+    if (info) {
+        engine->enumerated_.insert(MakeSessionHandle(SessionKind::Sink, info->index));
+    }
+    SinkCallback(context, info, eol, userdata);
+}
+
+void PulseEngine::SinkInputCallback(pa_context* context, const pa_sink_input_info* info, int eol, void* userdata) {
+    if (eol == 0 && info && !IsInternalStream(info->proplist)) {
+        static_cast<PulseEngine*>(userdata)->ApplySessionUpdate(MakeSinkInputSession(info));
+    }
+}
+
+void PulseEngine::SinkInputListCallback(pa_context* context, const pa_sink_input_info* info, int eol, void* userdata) {
+    PulseEngine* engine = static_cast<PulseEngine*>(userdata);
+    if (eol != 0) {
+        engine->EnumerationFinished();
+        return;
+    }
+    if (info) {
+        engine->enumerated_.insert(MakeSessionHandle(SessionKind::SinkInput, info->index));
+    }
+    SinkInputCallback(context, info, eol, userdata);
+}
+
+void PulseEngine::SourceCallback(pa_context* context, const pa_source_info* info, int eol, void* userdata) {
+    if (eol == 0 && info && !IsMonitorSource(info)) {
+        static_cast<PulseEngine*>(userdata)->ApplySessionUpdate(MakeSourceSession(info));
+    }
+}
+
+void PulseEngine::SourceListCallback(pa_context* context, const pa_source_info* info, int eol, void* userdata) {
+    PulseEngine* engine = static_cast<PulseEngine*>(userdata);
+    if (eol != 0) {
+        engine->EnumerationFinished();
+        return;
+    }
+    if (info) {
+        engine->enumerated_.insert(MakeSessionHandle(SessionKind::Source, info->index));
+    }
+    SourceCallback(context, info, eol, userdata);
+}
+
+void PulseEngine::SourceOutputCallback(pa_context* context, const pa_source_output_info* info, int eol, void* userdata) {
+    if (eol == 0 && info && !IsInternalStream(info->proplist)) {
+        static_cast<PulseEngine*>(userdata)->ApplySessionUpdate(MakeSourceOutputSession(info));
+    }
+}
+
+void PulseEngine::SourceOutputListCallback(pa_context* context, const pa_source_output_info* info, int eol, void* userdata) {
+    PulseEngine* engine = static_cast<PulseEngine*>(userdata);
+    if (eol != 0) {
+        engine->EnumerationFinished();
+        return;
+    }
+    if (info) {
+        engine->enumerated_.insert(MakeSessionHandle(SessionKind::SourceOutput, info->index));
+    }
+    SourceOutputCallback(context, info, eol, userdata);
+}
+
+void PulseEngine::ApplySessionUpdate(const AudioSession& session) {
+    AudioSession previous;
+    bool existed;
+    {
+        std::lock_guard<std::mutex> lock(table_mutex_);
+        auto it = sessions_.find(session.handle);
+        existed = it != sessions_.end();
+        if (existed) {
+            previous = it->second;
+            it->second = session;
+        } else {
+            sessions_.emplace(session.handle, session);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(observers_mutex_);
+    for (SessionObserver* observer : observers_) {
+        observer->OnSessionUpdated(session, existed ? &previous : nullptr);
+    }
+}
+
+void PulseEngine::ApplySessionRemoval(SessionHandle handle) {
+    AudioSession removed;
+    {
+        std::lock_guard<std::mutex> lock(table_mutex_);
+        auto it = sessions_.find(handle);
+        if (it == sessions_.end()) {
+            return;
+        }
+        removed = it->second;
+        sessions_.erase(it);
+    }
+
+    std::lock_guard<std::mutex> lock(observers_mutex_);
+    for (SessionObserver* observer : observers_) {
+        observer->OnSessionRemoved(removed);
+    }
+}
+
+void PulseEngine::ClearSessions() {
+    std::vector<SessionHandle> handles;
+    {
+        std::lock_guard<std::mutex> lock(table_mutex_);
+        for (const auto& entry : sessions_) {
+            handles.push_back(entry.first);
+        }
+    }
+
+    for (SessionHandle handle : handles) {
+        ApplySessionRemoval(handle);
+    }
+}
+
+std::vector<AudioSession> PulseEngine::GetSessions() const {
+    std::lock_guard<std::mutex> lock(table_mutex_);
+
+    std::vector<AudioSession> sessions;
+    sessions.reserve(sessions_.size());
+    for (const auto& entry : sessions_) {
+        sessions.push_back(entry.second);
+    }
+    return sessions;
+}
+
+bool PulseEngine::GetSession(SessionHandle handle, AudioSession* session) const {
+    std::lock_guard<std::mutex> lock(table_mutex_);
+
+    auto it = sessions_.find(handle);
+    if (it == sessions_.end()) {
+        return false;
+    }
+    *session = it->second;
+    return true;
+}
+
+void PulseEngine::AddObserver(SessionObserver* observer) {
+    std::lock_guard<std::mutex> lock(observers_mutex_);
+    if (std::find(observers_.begin(), observers_.end(), observer) == observers_.end()) {
+        observers_.push_back(observer);
+    }
+}
+
+void PulseEngine::RemoveObserver(SessionObserver* observer) {
+    std::lock_guard<std::mutex> lock(observers_mutex_);
+    observers_.erase(std::remove(observers_.begin(), observers_.end(), observer), observers_.end());
+}
+
+bool PulseEngine::RunAndWait(Request request, OperationResult* result) {
+    std::vector<OperationResult> results;
+    bool success = RunBatch({ std::move(request) }, &results) == 1;
+    if (result && !results.empty()) {
+        *result = results[0];
+    }
+    return success;
+}
+
+// Requests of one batch, tracked on the engine thread until every reply is
+// in or the connection that carries them goes away
+struct PulseEngine::Batch {
+    std::vector<OperationResult> results;
+    size_t pending;
+    bool finished = false;
+    BatchCompletion done;
+
+    void Finish() {
+        finished = true;
+        done(results);
+    }
+};
+
+void PulseEngine::FailBatches() {
+    // Operations on a dead context never call back; requests without a
+    // reply keep their default (failed) result
+    std::set<std::shared_ptr<Batch>> batches;
+    batches.swap(batches_);
+    for (const auto& batch : batches) {
+        if (!batch->finished) {
+            batch->Finish();
+        }
+    }
+}
+
+void PulseEngine::PostBatch(std::vector<Request> requests, BatchCompletion done) {
+    auto batch = std::make_shared<Batch>();
+    batch->results.resize(requests.size());
+    batch->pending = requests.size();
+    batch->done = std::move(done);
+
+    // Every request goes out before the first reply is read, so the batch
+    // costs one round trip however many requests it holds. Completions run on
+    // the engine thread, so the counter needs no lock.
+    Post([this, requests = std::move(requests), batch](pa_context* context) {
+        if (requests.empty()) {
+            batch->Finish();
+            return;
+        }
+        if (context) {
+            batches_.insert(batch);
+        }
+        for (size_t i = 0; i < requests.size(); i++) {
+            Completion done = [this, batch, i](OperationResult outcome) {
+                if (batch->finished) {
+                    return;
+                }
+                batch->results[i] = outcome;
+                if (--batch->pending == 0) {
+                    batches_.erase(batch);
+                    batch->Finish();
+                }
+            };
+            if (context) {
+                requests[i](context, done);
+            } else {
+                done(OperationResult());
+            }
+        }
+    });
+}
+
+size_t PulseEngine::RunBatch(std::vector<Request> requests, std::vector<OperationResult>* results) {
+    if (requests.empty()) {
+        return 0;
+    }
+
+    // The promise outlives a timed-out wait; the late completion just sets it
+    auto replies = std::make_shared<std::promise<std::vector<OperationResult>>>();
+    std::future<std::vector<OperationResult>> finished = replies->get_future();
+    PostBatch(std::move(requests), [replies](const std::vector<OperationResult>& outcomes) {
+        replies->set_value(outcomes);
+    });
+
+    if (finished.wait_for(kOperationTimeout) != std::future_status::ready) {
+        return 0;
+    }
+    std::vector<OperationResult> outcomes = finished.get();
+
+    size_t succeeded = 0;
+    for (const OperationResult& outcome : outcomes) {
+        if (outcome.success) {
+            succeeded++;
+        }
+    }
+    if (results) {
+        *results = std::move(outcomes);
+    }
+    return succeeded;
+}
+
+void* PulseEngine::WrapCompletion(Completion done) {
+    return new Completion(std::move(done));
+}
+
+void PulseEngine::SuccessCompletion(pa_context* context, int success, void* userdata) {
+    Completion* done = static_cast<Completion*>(userdata);
+    OperationResult result;
+    result.success = success != 0;
+    (*done)(result);
+    delete done;
+}
+
+void PulseEngine::IndexCompletion(pa_context* context, uint32_t index, void* userdata) {
+    Completion* done = static_cast<Completion*>(userdata);
+    OperationResult result;
+    result.success = index != PA_INVALID_INDEX;
+    result.index = index;
+    (*done)(result);
+    delete done;
+}
+
+void PulseEngine::FinishIssue(pa_operation* op, void* completion) {
+    if (op) {
+        pa_operation_unref(op);
+        return;
+    }
+
+    // The request never reached the server; fail it now
+    Completion* done = static_cast<Completion*>(completion);
+    (*done)(OperationResult());
+    delete done;
+}
+
+void PulseEngine::AddSubscriptionListener(SubscriptionListener* listener) {
+    std::lock_guard<std::mutex> lock(observers_mutex_);
+    if (std::find(subscription_listeners_.begin(), subscription_listeners_.end(), listener) ==
+        subscription_listeners_.end()) {
+        subscription_listeners_.push_back(listener);
+    }
+}
+
+void PulseEngine::RemoveSubscriptionListener(SubscriptionListener* listener) {
+    std::lock_guard<std::mutex> lock(observers_mutex_);
+    subscription_listeners_.erase(std::remove(subscription_listeners_.begin(), subscription_listeners_.end(), listener),
+                                  subscription_listeners_.end());
+}
+
+void PulseEngine::SetReplayMode(bool replay) {
+    Post([this, replay](pa_context* context) {
+        if (replaying_ == replay) {
+            return;
+        }
+
+        // Whatever the old source put in the table does not belong to the new one
+        Disconnect();
+        ready_ = false;
+        ClearSessions();
+        replaying_ = replay;
+
+        if (replay) {
+            ready_ = true;
+        } else {
+            Connect();
+        }
+    });
+}
+
+void PulseEngine::SetActivityMode(ActivityMode mode) {
+    if (mode_.exchange(mode) == mode) {
+        return;
+    }
+
+    Post([this, mode](pa_context* context) {
+        ApplyActivityMode(mode);
+    });
+}
+
+void PulseEngine::ApplyActivityMode(ActivityMode mode) {
+    ActivityMode previous = applied_mode_;
+    applied_mode_ = mode;
+
+    if (ready_ && context_ && SubscriptionMaskFor(previous) != SubscriptionMaskFor(mode)) {
+        pa_operation* op = pa_context_subscribe(context_, SubscriptionMaskFor(mode), nullptr, nullptr);
+        if (op) {
+            pa_operation_unref(op);
+        }
+
+        // Device events and stream changes were not followed while suspended;
+        // catch up in one pass
+        if (previous == ActivityMode::Suspended) {
+            Enumerate();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(observers_mutex_);
+    for (ActivityListener* listener : activity_listeners_) {
+        listener->OnActivityModeChanged(mode);
+    }
+}
+
+void PulseEngine::AddActivityListener(ActivityListener* listener) {
+    std::lock_guard<std::mutex> lock(observers_mutex_);
+    if (std::find(activity_listeners_.begin(), activity_listeners_.end(), listener) == activity_listeners_.end()) {
+        activity_listeners_.push_back(listener);
+    }
+}
+
+void PulseEngine::RemoveActivityListener(ActivityListener* listener) {
+    std::lock_guard<std::mutex> lock(observers_mutex_);
+    activity_listeners_.erase(std::remove(activity_listeners_.begin(), activity_listeners_.end(), listener),
+                              activity_listeners_.end());
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include "linux-audio-session.h"
+#include <pulse/pulseaudio.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+// Receives session table changes. Called on the engine thread, so
+// implementations must not block.
+class SessionObserver {
+public:
+    virtual ~SessionObserver() = default;
+
+    // previous is null when the session was not in the table before
+    virtual void OnSessionUpdated(const AudioSession& session, const AudioSession* previous) = 0;
+    virtual void OnSessionRemoved(const AudioSession& session) = 0;
+};
+
+// How much work the engine does on behalf of the UI
+enum class ActivityMode {
+    Foreground,  // Window visible: full subscription, prompt change delivery
+    Background,  // Window hidden or minimised: meters off, sparse change batches
+    Suspended    // Nobody is looking: only stream arrivals are followed, for rule enforcement
+};
+
+// Receives activity mode changes on the engine thread
+class ActivityListener {
+public:
+    virtual ~ActivityListener() = default;
+    virtual void OnActivityModeChanged(ActivityMode mode) = 0;
+
+    // The engine thread is exiting and its mainloop will be freed; drop any
+    // events created on it. Called on the engine thread.
+    virtual void OnEngineStopping() {}
+};
+
+// Receives raw subscription events on the engine thread, before the engine
+// queries the object they name
+class SubscriptionListener {
+public:
+    virtual ~SubscriptionListener() = default;
+    virtual void OnSubscriptionEvent(pa_subscription_event_type_t type, uint32_t index) = 0;
+};
+
+// Outcome of a request issued on the engine thread
+struct OperationResult {
+    bool success = false;
+    uint32_t index = PA_INVALID_INDEX;  // Object index for requests that create one
+};
+
+// Persistent PulseAudio connection that keeps a live session table.
+// The connection runs a pa_mainloop on its own thread and keeps the table
+// current from subscription events, so reads never touch the server.
+class PulseEngine {
+public:
+    typedef std::function<void(pa_context*)> Task;
+
+    static PulseEngine& Instance();
+
+    ~PulseEngine();
+
+    // Start the engine thread if needed. The first call waits (bounded) for the
+    // initial enumeration; returns whether the session table is live.
+    bool Start();
+    void Stop();
+    bool IsReady() const { return ready_; }
+
+    // Whether the engine thread is running, connected or not
+    bool IsRunning();
+
+    // Snapshot of the session table, ordered by handle (sinks, sink inputs,
+    // sources, source outputs)
+    std::vector<AudioSession> GetSessions() const;
+    bool GetSession(SessionHandle handle, AudioSession* session) const;
+
+    // Run a task on the engine thread. The context is null while disconnected.
+    void Post(Task task);
+
+    // Requests that finish asynchronously receive a Completion and must call it
+    // exactly once, on the engine thread
+    typedef std::function<void(OperationResult)> Completion;
+    typedef std::function<void(pa_context*, Completion)> Request;
+
+    // Issue a request from another thread and wait (bounded) for its result
+    bool RunAndWait(Request request, OperationResult* result = nullptr);
+
+    // Issue requests back to back and wait (bounded) for all of them; the
+    // batch shares one round trip. Returns how many succeeded; results are
+    // filled in request order unless the wait timed out.
+    size_t RunBatch(std::vector<Request> requests, std::vector<OperationResult>* results = nullptr);
+
+    // Issue requests back to back without waiting. done runs on the engine
+    // thread with the results in request order once every reply is in or the
+    // connection goes away; failed and unanswered requests read as failed.
+    typedef std::function<void(const std::vector<OperationResult>&)> BatchCompletion;
+    void PostBatch(std::vector<Request> requests, BatchCompletion done);
+
+    // Adapters between PulseAudio callbacks and a Completion. WrapCompletion
+    // returns the userdata; pass the returned operation to FinishIssue, which
+    // fails the completion if the request could not be sent.
+    static void* WrapCompletion(Completion done);
+    static void SuccessCompletion(pa_context* context, int success, void* userdata);
+    static void IndexCompletion(pa_context* context, uint32_t index, void* userdata);
+    static void FinishIssue(pa_operation* op, void* completion);
+
+    void AddObserver(SessionObserver* observer);
+    void RemoveObserver(SessionObserver* observer);
+
+    // Activity mode; listeners are told on the engine thread
+    void SetActivityMode(ActivityMode mode);
+    ActivityMode GetActivityMode() const { return mode_; }
+    void AddActivityListener(ActivityListener* listener);
+    void RemoveActivityListener(ActivityListener* listener);
+
+    void AddSubscriptionListener(SubscriptionListener* listener);
+    void RemoveSubscriptionListener(SubscriptionListener* listener);
+
+    // Detach from the server so a trace replay can drive the table (true), or
+    // reconnect (false). Applied on the engine thread; the table is emptied
+    // either way. Requests fail while replaying. Needs a started engine.
+    void SetReplayMode(bool replay);
+    bool IsReplaying() const { return replaying_; }
+
+    // Number of times the engine thread has woken from poll()
+    uint64_t GetWakeupCount() const { return wakeups_; }
+
+    // Mainloop API for timers and events; only valid on the engine thread
+    pa_mainloop_api* GetMainloopApi() const { return mainloop_api_; }
+
+    // Table mutations. Everything that changes the table goes through these two
+    // calls, whatever produced the data.
+    void ApplySessionUpdate(const AudioSession& session);
+    void ApplySessionRemoval(SessionHandle handle);
+
+private:
+    PulseEngine() = default;
+    PulseEngine(const PulseEngine&) = delete;
+    PulseEngine& operator=(const PulseEngine&) = delete;
+
+    void Run();
+    void Connect();
+    void ScheduleReconnect();
+    void RunPostedTasks();
+    void ClearSessions();
+    void Enumerate();
+    void EnumerationFinished();
+    void ApplyActivityMode(ActivityMode mode);
+    void Disconnect();
+    void FailBatches();
+
+    static int PollCallback(struct pollfd* fds, unsigned long count, int timeout, void* userdata);
+    static void ContextStateCallback(pa_context* context, void* userdata);
+    static void SubscribeCallback(pa_context* context, pa_subscription_event_type_t type, uint32_t index, void* userdata);
+    static void SinkCallback(pa_context* context, const pa_sink_info* info, int eol, void* userdata);
+    static void SinkListCallback(pa_context* context, const pa_sink_info* info, int eol, void* userdata);
+    static void SinkInputCallback(pa_context* context, const pa_sink_input_info* info, int eol, void* userdata);
+    static void SinkInputListCallback(pa_context* context, const pa_sink_input_info* info, int eol, void* userdata);
+    static void SourceCallback(pa_context* context, const pa_source_info* info, int eol, void* userdata);
+    static void SourceListCallback(pa_context* context, const pa_source_info* info, int eol, void* userdata);
+    static void SourceOutputCallback(pa_context* context, const pa_source_output_info* info, int eol, void* userdata);
+    static void SourceOutputListCallback(pa_context* context, const pa_source_output_info* info, int eol, void* userdata);
+    static void ReconnectCallback(pa_mainloop_api* api, pa_time_event* event, const struct timeval* tv, void* userdata);
+
+    pa_mainloop* mainloop_ = nullptr;
+    pa_mainloop_api* mainloop_api_ = nullptr;
+    pa_context* context_ = nullptr;
+    pa_time_event* reconnect_event_ = nullptr;
+    std::thread thread_;
+    std::atomic<bool> stopping_{false};
+    std::atomic<bool> ready_{false};
+    std::atomic<bool> replaying_{false};
+
+    // Enumeration bookkeeping (engine thread). Sessions not seen during a full
+    // enumeration are dropped when it finishes.
+    int pending_enumerations_ = 0;
+    bool enumerate_again_ = false;  // Another pass was asked for during this one
+    std::set<SessionHandle> enumerated_;
+
+    std::atomic<ActivityMode> mode_{ActivityMode::Foreground};
+    ActivityMode applied_mode_ = ActivityMode::Foreground; // Engine thread
+    std::atomic<uint64_t> wakeups_{0};
+
+    // Start() waits on this until the first enumeration completes
+    std::mutex start_mutex_;
+    std::condition_variable start_cv_;
+    bool started_ = false;
+    bool first_sync_done_ = false;
+
+    mutable std::mutex table_mutex_;
+    std::map<SessionHandle, AudioSession> sessions_;
+
+    // Batches awaiting replies (engine thread)
+    struct Batch;
+    std::set<std::shared_ptr<Batch>> batches_;
+
+    std::mutex tasks_mutex_;
+    std::vector<Task> tasks_;
+
+    std::mutex observers_mutex_;
+    std::vector<SessionObserver*> observers_;
+    std::vector<ActivityListener*> activity_listeners_;
+    std::vector<SubscriptionListener*> subscription_listeners_;
+};
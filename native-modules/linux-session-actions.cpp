@@ -0,0 +1,196 @@
+#include "linux-session-actions.h"
+#include "linux-mute-rules.h"
+#include "linux-session-operations.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <set>
+
+// How long a sent volume stands in for the table's value
+const auto kSentVolumeLifetime = std::chrono::milliseconds(500);
+
+SessionActions& SessionActions::Instance() {
+    static SessionActions actions;
+    return actions;
+}
+
+bool SessionActions::IsValidAction(const SessionAction& action) {
+    if (action.pattern.empty()) {
+        return false;
+    }
+    if (action.type == SessionActionType::VolumeStep) {
+        return std::isfinite(action.step) && action.step != 0.0f && std::fabs(action.step) <= 100.0f;
+    }
+    return true;
+}
+
+// Case-insensitive glob match with backtracking on the last '*'
+bool SessionActions::MatchesPattern(const std::string& pattern, const std::string& name) {
+    size_t p = 0;
+    size_t n = 0;
+    size_t star = std::string::npos;
+    size_t resume = 0;
+
+    while (n < name.size()) {
+        if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            resume = n;
+        } else if (p < pattern.size() &&
+                   (pattern[p] == '?' ||
+                    std::tolower(static_cast<unsigned char>(pattern[p])) == std::tolower(static_cast<unsigned char>(name[n])))) {
+            p++;
+            n++;
+        } else if (star != std::string::npos) {
+            p = star + 1;
+            n = ++resume;
+        } else {
+            return false;
+        }
+    }
+
+    while (p < pattern.size() && pattern[p] == '*') {
+        p++;
+    }
+    return p == pattern.size();
+}
+
+bool SessionActions::Define(const std::string& name, const SessionAction& action) {
+    if (name.empty() || !IsValidAction(action)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& entry = actions_[name];
+    entry = Entry();
+    entry.action = action;
+    return true;
+}
+
+bool SessionActions::Remove(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return actions_.erase(name) > 0;
+}
+
+float SessionActions::CurrentVolume(const AudioSession& session, Clock::time_point now) {
+    auto sent = sent_.find(session.handle);
+    if (sent != sent_.end() && now - sent->second.at < kSentVolumeLifetime) {
+        return sent->second.volume;
+    }
+    return session.volume;
+}
+
+bool SessionActions::Run(const std::string& name, ResultCallback done) {
+    Clock::time_point start = Clock::now();
+    SessionAction action;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = actions_.find(name);
+        if (it == actions_.end()) {
+            return false;
+        }
+        action = it->second.action;
+    }
+
+    PulseEngine& engine = PulseEngine::Instance();
+    SessionActionResult outcome;
+    outcome.type = action.type;
+    std::vector<AudioSession> matches;
+    if (engine.Start()) {
+        SessionKind kind = action.capture ? SessionKind::SourceOutput : SessionKind::SinkInput;
+        for (AudioSession& session : engine.GetSessions()) {
+            if (GetHandleKind(session.handle) == kind && MatchesPattern(action.pattern, session.name)) {
+                matches.push_back(std::move(session));
+            }
+        }
+    }
+    outcome.matched = matches.size();
+
+    std::set<std::string> names;
+    for (const AudioSession& session : matches) {
+        names.insert(session.name);
+    }
+    outcome.names.assign(names.begin(), names.end());
+
+    std::vector<PulseEngine::Request> requests;
+    std::vector<SessionHandle> targets;
+    requests.reserve(matches.size());
+
+    if (action.type == SessionActionType::VolumeStep) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = sent_.begin(); it != sent_.end();) {
+            it = start - it->second.at >= kSentVolumeLifetime ? sent_.erase(it) : std::next(it);
+        }
+
+        for (const AudioSession& session : matches) {
+            float volume = std::min(100.0f, std::max(0.0f, CurrentVolume(session, start) + action.step));
+            sent_[session.handle] = { volume, start };
+
+            requests.push_back(VolumeRequest(session.handle, ScaledVolume(session, volume)));
+            targets.push_back(session.handle);
+        }
+    } else {
+        bool muted = action.type == SessionActionType::Mute;
+        if (action.type == SessionActionType::ToggleMute) {
+            muted = std::any_of(matches.begin(), matches.end(), [](const AudioSession& session) { return !session.muted; });
+        }
+        outcome.muted = muted;
+
+        // Saved states follow the hotkey, as they follow a click in the UI;
+        // otherwise the rule enforcer would undo it
+        if (!action.capture) {
+            for (const std::string& appName : outcome.names) {
+                MuteRuleEnforcer::Instance().SetRule(appName, muted);
+            }
+        }
+        for (const AudioSession& session : matches) {
+            requests.push_back(MuteRequest(session.handle, muted));
+        }
+    }
+
+    // The caller may be the UI thread, so the batch completes on the engine
+    // thread instead of being waited for
+    engine.PostBatch(std::move(requests),
+                     [this, name, start, targets = std::move(targets), outcome = std::move(outcome),
+                      done = std::move(done)](const std::vector<OperationResult>& results) mutable {
+        for (const OperationResult& result : results) {
+            if (result.success) {
+                outcome.applied++;
+            }
+        }
+        outcome.elapsed_usec = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            // A step the server refused must not become the base of the next
+            // press; later presses own the entry if they overwrote it
+            for (size_t i = 0; i < targets.size(); i++) {
+                auto sent = sent_.find(targets[i]);
+                if (!results[i].success && sent != sent_.end() && sent->second.at == start) {
+                    sent_.erase(sent);
+                }
+            }
+
+            auto it = actions_.find(name);
+            if (it != actions_.end()) {
+                it->second.runs++;
+                it->second.last_usec = outcome.elapsed_usec;
+                it->second.max_usec = std::max(it->second.max_usec, outcome.elapsed_usec);
+            }
+        }
+
+        if (done) {
+            done(std::move(outcome));
+        }
+    });
+    return true;
+}
+
+std::vector<SessionActionStats> SessionActions::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<SessionActionStats> stats;
+    stats.reserve(actions_.size());
+    for (const auto& entry : actions_) {
+        stats.push_back({ entry.first, entry.second.runs, entry.second.last_usec, entry.second.max_usec });
+    }
+    return stats;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "linux-audio-session.h"
+#include "linux-pulse-engine.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// What an action does to every session it matches
+enum class SessionActionType {
+    VolumeStep,  // Add step percentage points to the volume, clamped to 0-100
+    ToggleMute,  // Mute all matches unless all are muted already, then unmute them
+    Mute,
+    Unmute
+};
+
+// Named action bound to an application-name matcher, for hotkeys
+struct SessionAction {
+    std::string pattern;   // Application name, case-insensitive; '*' and '?' are wildcards
+    SessionActionType type = SessionActionType::VolumeStep;
+    float step = 0.0f;     // VolumeStep only
+    bool capture = false;  // Act on capture streams instead of playback streams
+};
+
+struct SessionActionResult {
+    SessionActionType type = SessionActionType::VolumeStep;
+    size_t matched = 0;
+    size_t applied = 0;
+    bool muted = false;              // State applied by mute actions
+    std::vector<std::string> names;  // Distinct application names acted on
+    uint64_t elapsed_usec = 0;       // From the call to the last acknowledgement
+};
+
+struct SessionActionStats {
+    std::string name;
+    uint64_t runs;
+    uint64_t last_usec;
+    uint64_t max_usec;
+};
+
+// Resolves named actions against the engine's session table and sends the
+// resulting volume and mute requests as one pipelined batch, so a hotkey
+// costs one round trip on the persistent connection however many streams
+// it touches.
+class SessionActions {
+public:
+    static SessionActions& Instance();
+
+    static bool IsValidAction(const SessionAction& action);
+    static bool MatchesPattern(const std::string& pattern, const std::string& name);
+
+    // Add or replace an action; returns false if it is invalid
+    bool Define(const std::string& name, const SessionAction& action);
+    bool Remove(const std::string& name);
+
+    // Run an action without waiting for the server; done is called on the
+    // engine thread once every request is acknowledged or has failed.
+    // Returns false, and never calls done, if no action has that name.
+    typedef std::function<void(SessionActionResult&&)> ResultCallback;
+    bool Run(const std::string& name, ResultCallback done);
+
+    std::vector<SessionActionStats> GetStats();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Entry {
+        SessionAction action;
+        uint64_t runs = 0;
+        uint64_t last_usec = 0;
+        uint64_t max_usec = 0;
+    };
+
+    // Volume this class last sent to a stream. Repeated presses can outrun
+    // the table update for the previous one, so a recent step builds on it.
+    struct SentVolume {
+        float volume;
+        Clock::time_point at;
+    };
+
+    SessionActions() = default;
+
+    float CurrentVolume(const AudioSession& session, Clock::time_point now);
+
+    std::mutex mutex_;
+    std::map<std::string, Entry> actions_;
+    std::map<SessionHandle, SentVolume> sent_;
+};
@@ -0,0 +1,478 @@
+#include "linux-session-history.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+// Number of sessions tracked at once; the oldest ended session is recycled first
+const size_t kMaxTrackedSessions = 32;
+
+// Resolution tiers, finest first: 5 minutes at 1 s, 1 hour at 10 s, 6 hours at 1 min
+struct HistoryTierSpec {
+    uint32_t resolution_ms;
+    uint32_t capacity;
+};
+const HistoryTierSpec kHistoryTiers[] = {
+    { 1000, 300 },
+    { 10000, 360 },
+    { 60000, 360 },
+};
+const size_t kHistoryTierCount = sizeof(kHistoryTiers) / sizeof(kHistoryTiers[0]);
+
+// Session names are kept in fixed storage and cut to this many bytes
+const size_t kHistoryNameWords = 16;
+const size_t kHistoryNameBytes = kHistoryNameWords * sizeof(uint64_t) - 1;
+
+const uint64_t kNoEpoch = std::numeric_limits<uint64_t>::max();
+const float kNoPeak = std::numeric_limits<float>::quiet_NaN();
+
+// Volume and mute state; written by the engine thread only
+struct SessionHistory::Bucket {
+    std::atomic<uint32_t> sequence{0};
+    std::atomic<uint64_t> epoch{kNoEpoch}; // Bucket start divided by the tier resolution
+    std::atomic<float> volume{0.0f};
+    std::atomic<float> volume_min{0.0f};
+    std::atomic<float> volume_max{0.0f};
+    std::atomic<bool> muted_any{false};
+    std::atomic<bool> muted_last{false};
+    std::atomic<bool> ended{false};         // The session was gone at the end of the bucket
+};
+
+// Meter peaks; written by the meter thread only. Tagged with the slot
+// generation instead of being reset, so a recycled slot ignores old peaks.
+struct SessionHistory::PeakBucket {
+    std::atomic<uint32_t> sequence{0};
+    std::atomic<uint64_t> epoch{kNoEpoch};
+    std::atomic<uint32_t> generation{0};
+    std::atomic<float> peak{kNoPeak};
+};
+
+struct SessionHistory::Slot {
+    std::atomic<SessionHandle> handle{kInvalidSessionHandle};
+    std::atomic<uint32_t> generation{0};  // Bumped when the slot is recycled
+    std::atomic<bool> active{false};
+    std::atomic<uint64_t> first_ms{0};
+    std::atomic<uint64_t> last_ms{0};
+
+    // Last recorded state, carried into new buckets (engine thread)
+    float volume = 0.0f;
+    bool muted = false;
+
+    // NUL-terminated name, published like a bucket
+    std::atomic<uint32_t> name_sequence{0};
+    std::atomic<uint64_t> name[kHistoryNameWords] = {};
+
+    std::unique_ptr<Bucket[]> tiers[kHistoryTierCount];
+    std::unique_ptr<PeakBucket[]> peak_tiers[kHistoryTierCount];
+};
+
+// Copy of a bucket taken by a reader
+struct SessionHistory::BucketSnapshot {
+    uint64_t epoch;
+    float volume;
+    float volume_min;
+    float volume_max;
+    bool muted_any;
+    bool muted_last;
+    bool ended;
+};
+
+// Seqlock-style read: retry while a write is in flight (odd sequence) or raced the copy
+bool SessionHistory::ReadBucket(const Bucket& bucket, BucketSnapshot* out) {
+    for (int attempt = 0; attempt < 16; attempt++) {
+        uint32_t before = bucket.sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+
+        out->epoch = bucket.epoch.load(std::memory_order_relaxed);
+        out->volume = bucket.volume.load(std::memory_order_relaxed);
+        out->volume_min = bucket.volume_min.load(std::memory_order_relaxed);
+        out->volume_max = bucket.volume_max.load(std::memory_order_relaxed);
+        out->muted_any = bucket.muted_any.load(std::memory_order_relaxed);
+        out->muted_last = bucket.muted_last.load(std::memory_order_relaxed);
+        out->ended = bucket.ended.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (bucket.sequence.load(std::memory_order_relaxed) == before) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Same retry loop for a peak bucket; false unless it holds this epoch of this slot generation
+bool SessionHistory::ReadPeak(const PeakBucket& bucket, uint64_t epoch, uint32_t generation, float* peak) {
+    for (int attempt = 0; attempt < 16; attempt++) {
+        uint32_t before = bucket.sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+
+        bool match = bucket.epoch.load(std::memory_order_relaxed) == epoch &&
+                     bucket.generation.load(std::memory_order_relaxed) == generation;
+        float value = bucket.peak.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (bucket.sequence.load(std::memory_order_relaxed) == before) {
+            *peak = value;
+            return match;
+        }
+    }
+    return false;
+}
+
+void SessionHistory::StoreName(Slot* slot, const std::string& name) {
+    // Cut on a UTF-8 character boundary
+    size_t length = std::min(name.size(), kHistoryNameBytes);
+    while (length > 0 && length < name.size() && (static_cast<unsigned char>(name[length]) & 0xC0) == 0x80) {
+        length--;
+    }
+
+    uint64_t words[kHistoryNameWords] = {};
+    std::memcpy(words, name.data(), length);
+
+    uint32_t sequence = slot->name_sequence.load(std::memory_order_relaxed);
+    slot->name_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < kHistoryNameWords; i++) {
+        slot->name[i].store(words[i], std::memory_order_relaxed);
+    }
+    slot->name_sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool SessionHistory::LoadName(const Slot& slot, std::string* name) {
+    for (int attempt = 0; attempt < 16; attempt++) {
+        uint32_t before = slot.name_sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+
+        uint64_t words[kHistoryNameWords];
+        for (size_t i = 0; i < kHistoryNameWords; i++) {
+            words[i] = slot.name[i].load(std::memory_order_relaxed);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.name_sequence.load(std::memory_order_relaxed) == before) {
+            const char* bytes = reinterpret_cast<const char*>(words);
+            name->assign(bytes, strnlen(bytes, kHistoryNameBytes));
+            return true;
+        }
+    }
+    return false;
+}
+
+SessionHistory& SessionHistory::Instance() {
+    static SessionHistory history;
+    return history;
+}
+
+SessionHistory::SessionHistory() : slots_(new Slot[kMaxTrackedSessions]) {
+    for (size_t i = 0; i < kMaxTrackedSessions; i++) {
+        for (size_t tier = 0; tier < kHistoryTierCount; tier++) {
+            slots_[i].tiers[tier].reset(new Bucket[kHistoryTiers[tier].capacity]);
+            slots_[i].peak_tiers[tier].reset(new PeakBucket[kHistoryTiers[tier].capacity]);
+        }
+    }
+}
+
+uint64_t SessionHistory::NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+SessionHistory::Slot* SessionHistory::FindSlot(SessionHandle handle) const {
+    for (size_t i = 0; i < kMaxTrackedSessions; i++) {
+        if (slots_[i].handle.load(std::memory_order_acquire) == handle) {
+            return &slots_[i];
+        }
+    }
+    return nullptr;
+}
+
+SessionHistory::Slot* SessionHistory::ClaimSlot(const AudioSession& session, uint64_t now_ms) {
+    Slot* slot = FindSlot(session.handle);
+    if (slot) {
+        // A handle that comes back (reused index, reconnect, replay) is live
+        // again from here on. Its earlier buckets stay as history, and the
+        // stretch it was gone stays absent: the bucket written on removal
+        // ends it, and the state carried into the next bucket starts fresh.
+        if (!slot->active.load(std::memory_order_relaxed)) {
+            StoreName(slot, session.name);
+            slot->volume = session.volume;
+            slot->muted = session.muted;
+            slot->active.store(true, std::memory_order_release);
+        }
+        return slot;
+    }
+
+    // Prefer an unused slot, then the ended session seen least recently,
+    // then the least recently updated live one
+    Slot* victim = nullptr;
+    for (size_t i = 0; i < kMaxTrackedSessions; i++) {
+        Slot* candidate = &slots_[i];
+        if (candidate->handle.load(std::memory_order_relaxed) == kInvalidSessionHandle) {
+            victim = candidate;
+            break;
+        }
+        if (!victim) {
+            victim = candidate;
+            continue;
+        }
+        bool candidateActive = candidate->active.load(std::memory_order_relaxed);
+        bool victimActive = victim->active.load(std::memory_order_relaxed);
+        if (candidateActive != victimActive) {
+            if (!candidateActive) {
+                victim = candidate;
+            }
+        } else if (candidate->last_ms.load(std::memory_order_relaxed) < victim->last_ms.load(std::memory_order_relaxed)) {
+            victim = candidate;
+        }
+    }
+
+    // Hide the slot from readers while it is reset. Peak buckets are not
+    // touched; the new generation makes their old contents stale.
+    victim->handle.store(kInvalidSessionHandle, std::memory_order_release);
+    victim->generation.fetch_add(1, std::memory_order_acq_rel);
+    for (size_t tier = 0; tier < kHistoryTierCount; tier++) {
+        for (uint32_t i = 0; i < kHistoryTiers[tier].capacity; i++) {
+            Bucket& bucket = victim->tiers[tier][i];
+            uint32_t sequence = bucket.sequence.load(std::memory_order_relaxed);
+            bucket.sequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            bucket.epoch.store(kNoEpoch, std::memory_order_relaxed);
+            bucket.sequence.store(sequence + 2, std::memory_order_release);
+        }
+    }
+
+    victim->volume = session.volume;
+    victim->muted = session.muted;
+    victim->first_ms.store(now_ms, std::memory_order_relaxed);
+    victim->last_ms.store(now_ms, std::memory_order_relaxed);
+    victim->active.store(true, std::memory_order_relaxed);
+    StoreName(victim, session.name);
+    victim->handle.store(session.handle, std::memory_order_release);
+    return victim;
+}
+
+void SessionHistory::Record(Slot* slot, uint64_t now_ms, float volume, bool muted, bool ended) {
+    for (size_t tier = 0; tier < kHistoryTierCount; tier++) {
+        const HistoryTierSpec& spec = kHistoryTiers[tier];
+        uint64_t epoch = now_ms / spec.resolution_ms;
+        Bucket& bucket = slot->tiers[tier][epoch % spec.capacity];
+
+        uint32_t sequence = bucket.sequence.load(std::memory_order_relaxed);
+        bucket.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        if (bucket.epoch.load(std::memory_order_relaxed) != epoch) {
+            // New bucket: the carried state held from the bucket start until now
+            bucket.epoch.store(epoch, std::memory_order_relaxed);
+            bucket.volume_min.store(std::min(slot->volume, volume), std::memory_order_relaxed);
+            bucket.volume_max.store(std::max(slot->volume, volume), std::memory_order_relaxed);
+            bucket.muted_any.store(slot->muted || muted, std::memory_order_relaxed);
+        } else {
+            bucket.volume_min.store(std::min(bucket.volume_min.load(std::memory_order_relaxed), volume), std::memory_order_relaxed);
+            bucket.volume_max.store(std::max(bucket.volume_max.load(std::memory_order_relaxed), volume), std::memory_order_relaxed);
+            if (muted) {
+                bucket.muted_any.store(true, std::memory_order_relaxed);
+            }
+        }
+        bucket.volume.store(volume, std::memory_order_relaxed);
+        bucket.muted_last.store(muted, std::memory_order_relaxed);
+        bucket.ended.store(ended, std::memory_order_relaxed);
+
+        bucket.sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    slot->volume = volume;
+    slot->muted = muted;
+    slot->last_ms.store(now_ms, std::memory_order_relaxed);
+}
+
+void SessionHistory::OnSessionUpdated(const AudioSession& session, const AudioSession* previous) {
+    // Only changes are recorded; queries carry the last state forward
+    if (previous && previous->volume == session.volume && previous->muted == session.muted &&
+        previous->name == session.name) {
+        return;
+    }
+
+    uint64_t now = NowMs();
+    Slot* slot = ClaimSlot(session, now);
+    if (previous && previous->name != session.name) {
+        StoreName(slot, session.name);
+    }
+    Record(slot, now, session.volume, session.muted, false);
+}
+
+void SessionHistory::OnSessionRemoved(const AudioSession& session) {
+    Slot* slot = FindSlot(session.handle);
+    if (!slot || !slot->active.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    // Mark the end in the buckets so queries stop carrying the state forward
+    Record(slot, NowMs(), slot->volume, slot->muted, true);
+    slot->active.store(false, std::memory_order_release);
+}
+
+void SessionHistory::RecordPeak(SessionHandle handle, float peak) {
+    Slot* slot = FindSlot(handle);
+    if (!slot || !slot->active.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    // A slot recycled after FindSlot either no longer holds the handle or has
+    // moved past this generation, and readers ignore peaks from old generations
+    uint32_t generation = slot->generation.load(std::memory_order_acquire);
+    if (slot->handle.load(std::memory_order_acquire) != handle) {
+        return;
+    }
+
+    uint64_t now = NowMs();
+    for (size_t tier = 0; tier < kHistoryTierCount; tier++) {
+        const HistoryTierSpec& spec = kHistoryTiers[tier];
+        uint64_t epoch = now / spec.resolution_ms;
+        PeakBucket& bucket = slot->peak_tiers[tier][epoch % spec.capacity];
+
+        uint32_t sequence = bucket.sequence.load(std::memory_order_relaxed);
+        bucket.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        float previousPeak = bucket.peak.load(std::memory_order_relaxed);
+        if (bucket.epoch.load(std::memory_order_relaxed) != epoch ||
+            bucket.generation.load(std::memory_order_relaxed) != generation) {
+            bucket.epoch.store(epoch, std::memory_order_relaxed);
+            bucket.generation.store(generation, std::memory_order_relaxed);
+            bucket.peak.store(peak, std::memory_order_relaxed);
+        } else if (std::isnan(previousPeak) || peak > previousPeak) {
+            bucket.peak.store(peak, std::memory_order_relaxed);
+        }
+
+        bucket.sequence.store(sequence + 2, std::memory_order_release);
+    }
+}
+
+uint32_t SessionHistory::Query(SessionHandle handle, uint64_t from_ms, uint64_t to_ms, uint32_t min_resolution_ms,
+                               std::vector<double>* rows) const {
+    Slot* slot = FindSlot(handle);
+    if (!slot) {
+        return 0;
+    }
+    uint32_t generation = slot->generation.load(std::memory_order_acquire);
+
+    uint64_t now = NowMs();
+    to_ms = std::min(to_ms, now);
+    if (from_ms > to_ms) {
+        return 0;
+    }
+
+    // Finest tier that is coarse enough and still reaches back to from_ms
+    size_t tier = kHistoryTierCount - 1;
+    for (size_t i = 0; i < kHistoryTierCount; i++) {
+        const HistoryTierSpec& spec = kHistoryTiers[i];
+        uint64_t span = static_cast<uint64_t>(spec.resolution_ms) * spec.capacity;
+        if (spec.resolution_ms >= min_resolution_ms && now - from_ms < span) {
+            tier = i;
+            break;
+        }
+    }
+    const HistoryTierSpec& spec = kHistoryTiers[tier];
+    const Bucket* buckets = slot->tiers[tier].get();
+    const PeakBucket* peaks = slot->peak_tiers[tier].get();
+
+    uint64_t nowEpoch = now / spec.resolution_ms;
+    uint64_t oldestEpoch = nowEpoch >= spec.capacity ? nowEpoch - spec.capacity + 1 : 0;
+    uint64_t firstEpoch = std::max(from_ms / spec.resolution_ms, oldestEpoch);
+    uint64_t lastEpoch = to_ms / spec.resolution_ms;
+    if (firstEpoch > lastEpoch) {
+        return spec.resolution_ms;
+    }
+
+    uint64_t firstMs = slot->first_ms.load(std::memory_order_relaxed);
+
+    auto read = [&](uint64_t epoch, BucketSnapshot* snapshot) {
+        return ReadBucket(buckets[epoch % spec.capacity], snapshot) && snapshot->epoch == epoch;
+    };
+    auto readPeak = [&](uint64_t epoch) {
+        float peak;
+        return ReadPeak(peaks[epoch % spec.capacity], epoch, generation, &peak) ? static_cast<double>(peak) : kNoPeak;
+    };
+
+    // State carried into the range from the most recent bucket before it; a
+    // bucket that ended the session carries absence until it comes back
+    double carryVolume = std::numeric_limits<double>::quiet_NaN();
+    double carryMuted = std::numeric_limits<double>::quiet_NaN();
+    bool carryEnded = false;
+    BucketSnapshot snapshot;
+    for (uint64_t epoch = firstEpoch; epoch > oldestEpoch; ) {
+        epoch--;
+        if (read(epoch, &snapshot)) {
+            carryVolume = snapshot.volume;
+            carryMuted = snapshot.muted_last ? 1.0 : 0.0;
+            carryEnded = snapshot.ended;
+            break;
+        }
+    }
+
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    size_t start = rows->size();
+    rows->reserve(start + (lastEpoch - firstEpoch + 1) * kHistoryColumnCount);
+
+    for (uint64_t epoch = firstEpoch; epoch <= lastEpoch; epoch++) {
+        uint64_t bucketMs = epoch * spec.resolution_ms;
+        bool present = bucketMs + spec.resolution_ms > firstMs;
+
+        rows->push_back(static_cast<double>(bucketMs));
+        if (present && read(epoch, &snapshot)) {
+            rows->push_back(snapshot.volume);
+            rows->push_back(snapshot.volume_min);
+            rows->push_back(snapshot.volume_max);
+            rows->push_back(snapshot.muted_any ? 1.0 : 0.0);
+            rows->push_back(readPeak(epoch));
+            carryVolume = snapshot.volume;
+            carryMuted = snapshot.muted_last ? 1.0 : 0.0;
+            carryEnded = snapshot.ended;
+        } else if (present && !carryEnded) {
+            rows->push_back(carryVolume);
+            rows->push_back(carryVolume);
+            rows->push_back(carryVolume);
+            rows->push_back(carryMuted);
+            rows->push_back(readPeak(epoch));
+        } else {
+            rows->insert(rows->end(), kHistoryColumnCount - 1, nan);
+        }
+    }
+
+    // Discard the result if the slot was recycled underneath the read
+    if (slot->generation.load(std::memory_order_acquire) != generation) {
+        rows->resize(start);
+        return 0;
+    }
+
+    return spec.resolution_ms;
+}
+
+std::vector<SessionHistory::TrackedSession> SessionHistory::GetTrackedSessions() const {
+    std::vector<TrackedSession> sessions;
+
+    for (size_t i = 0; i < kMaxTrackedSessions; i++) {
+        const Slot& slot = slots_[i];
+        SessionHandle handle = slot.handle.load(std::memory_order_acquire);
+        if (handle == kInvalidSessionHandle) {
+            continue;
+        }
+
+        TrackedSession session;
+        session.handle = handle;
+        session.active = slot.active.load(std::memory_order_relaxed);
+        session.first_ms = slot.first_ms.load(std::memory_order_relaxed);
+        session.last_ms = slot.last_ms.load(std::memory_order_relaxed);
+        LoadName(slot, &session.name);
+        sessions.push_back(session);
+    }
+
+    return sessions;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "linux-audio-session.h"
+#include "linux-pulse-engine.h"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Columns of each row returned by SessionHistory::Query
+enum HistoryColumn {
+    kHistoryTime = 0,     // Bucket start, milliseconds since the Unix epoch
+    kHistoryVolume,       // Last volume in the bucket (0-100)
+    kHistoryVolumeMin,
+    kHistoryVolumeMax,
+    kHistoryMuted,        // 1 if the session was muted at any point in the bucket
+    kHistoryPeak,         // Highest peak level (0-1), NaN when no meter was running
+    kHistoryColumnCount
+};
+
+// Fixed-memory activity history for audio sessions.
+//
+// Every tracked session owns one ring of buckets per resolution tier. Each
+// write updates the current bucket of every tier, so coarser tiers hold the
+// downsampled aggregate of the finer ones without a separate pass.
+//
+// Nothing a writer touches has a second writer, so writers never wait: the
+// engine thread alone claims slots, renames them and records volume and mute,
+// and the meter thread alone records peaks, into a parallel ring. Readers
+// never block either side; every bucket and name is published with a
+// sequence counter and the read is retried if a write raced it.
+class SessionHistory : public SessionObserver {
+public:
+    struct TrackedSession {
+        SessionHandle handle;
+        std::string name;
+        bool active;
+        uint64_t first_ms;
+        uint64_t last_ms;
+    };
+
+    static SessionHistory& Instance();
+
+    void OnSessionUpdated(const AudioSession& session, const AudioSession* previous) override;
+    void OnSessionRemoved(const AudioSession& session) override;
+
+    // Record a peak level (0-1) from a meter. Ignored for untracked sessions.
+    // Called only from the stream loop thread, the single peak writer.
+    void RecordPeak(SessionHandle handle, float peak);
+
+    // Append rows (kHistoryColumnCount doubles each) covering [from_ms, to_ms]
+    // using the finest tier that spans the range with at least min_resolution_ms.
+    // Returns the resolution used, or 0 if the session is not tracked.
+    uint32_t Query(SessionHandle handle, uint64_t from_ms, uint64_t to_ms, uint32_t min_resolution_ms,
+                   std::vector<double>* rows) const;
+
+    std::vector<TrackedSession> GetTrackedSessions() const;
+
+    static uint64_t NowMs();
+
+private:
+    struct Bucket;
+    struct PeakBucket;
+    struct BucketSnapshot;
+    struct Slot;
+
+    SessionHistory();
+
+    Slot* FindSlot(SessionHandle handle) const;
+
+    // The following run on the engine thread only
+    Slot* ClaimSlot(const AudioSession& session, uint64_t now_ms);
+    void Record(Slot* slot, uint64_t now_ms, float volume, bool muted, bool ended);
+    static void StoreName(Slot* slot, const std::string& name);
+
+    static bool ReadBucket(const Bucket& bucket, BucketSnapshot* snapshot);
+    static bool ReadPeak(const PeakBucket& bucket, uint64_t epoch, uint32_t generation, float* peak);
+    static bool LoadName(const Slot& slot, std::string* name);
+
+    std::unique_ptr<Slot[]> slots_;
+};
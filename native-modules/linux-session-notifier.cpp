@@ -0,0 +1,226 @@
+#include "linux-session-notifier.h"
+#include <pulse/timeval.h>
+#include <algorithm>
+#include <limits>
+
+// Delay between a change and its delivery in each mode
+const pa_usec_t kForegroundFlushDelay = 50 * PA_USEC_PER_MSEC;
+const pa_usec_t kBackgroundFlushDelay = 10 * PA_USEC_PER_SEC;
+
+static pa_usec_t WallClockUsec() {
+    struct timeval tv;
+    return pa_timeval_load(pa_gettimeofday(&tv));
+}
+
+SessionChangeNotifier& SessionChangeNotifier::Instance() {
+    static SessionChangeNotifier notifier;
+    return notifier;
+}
+
+SessionChangeNotifier::SubscriptionId SessionChangeNotifier::Subscribe(Sink sink, uint32_t min_interval_ms) {
+    SubscriptionId id;
+    {
+        std::lock_guard<std::mutex> lock(subscribers_mutex_);
+        id = next_id_++;
+        Subscriber& subscriber = subscribers_[id];
+        subscriber.sink = std::move(sink);
+        subscriber.min_interval = min_interval_ms * PA_USEC_PER_MSEC;
+    }
+
+    // Seed the first batch with the whole table so the subscriber starts
+    // complete. Seeding on the engine thread keeps it in order with updates.
+    PulseEngine& engine = PulseEngine::Instance();
+    engine.Post([this, id, &engine](pa_context* context) {
+        {
+            std::lock_guard<std::mutex> lock(subscribers_mutex_);
+            auto it = subscribers_.find(id);
+            if (it == subscribers_.end()) {
+                return;
+            }
+            for (const AudioSession& session : engine.GetSessions()) {
+                it->second.changed.insert(session.handle);
+            }
+            it->second.pending_since = WallClockUsec();
+        }
+        ScheduleFlush();
+    });
+    return id;
+}
+
+bool SessionChangeNotifier::Unsubscribe(SubscriptionId id) {
+    std::lock_guard<std::mutex> lock(subscribers_mutex_);
+    return subscribers_.erase(id) > 0;
+}
+
+void SessionChangeNotifier::UnsubscribeAll() {
+    std::lock_guard<std::mutex> lock(subscribers_mutex_);
+    subscribers_.clear();
+}
+
+bool SessionChangeNotifier::SetMinInterval(SubscriptionId id, uint32_t min_interval_ms) {
+    {
+        std::lock_guard<std::mutex> lock(subscribers_mutex_);
+        auto it = subscribers_.find(id);
+        if (it == subscribers_.end()) {
+            return false;
+        }
+        it->second.min_interval = min_interval_ms * PA_USEC_PER_MSEC;
+    }
+
+    PulseEngine::Instance().Post([this](pa_context* context) {
+        ScheduleFlush();
+    });
+    return true;
+}
+
+size_t SessionChangeNotifier::GetSubscriberCount() {
+    std::lock_guard<std::mutex> lock(subscribers_mutex_);
+    return subscribers_.size();
+}
+
+void SessionChangeNotifier::OnSessionUpdated(const AudioSession& session, const AudioSession* previous) {
+    // Latency and format updates are not interesting to the mixer UI; a
+    // stream moving to another device or between channels is
+    if (previous && previous->name == session.name && previous->volume == session.volume &&
+        previous->muted == session.muted && previous->device_index == session.device_index &&
+        pa_cvolume_equal(&previous->cvolume, &session.cvolume)) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(subscribers_mutex_);
+        if (subscribers_.empty()) {
+            return;
+        }
+
+        pa_usec_t now = WallClockUsec();
+        for (auto& entry : subscribers_) {
+            Subscriber& subscriber = entry.second;
+            subscriber.removed.erase(session.handle);
+            subscriber.changed.insert(session.handle);
+            if (!subscriber.pending_since) {
+                subscriber.pending_since = now;
+            }
+        }
+    }
+    ScheduleFlush();
+}
+
+void SessionChangeNotifier::OnSessionRemoved(const AudioSession& session) {
+    {
+        std::lock_guard<std::mutex> lock(subscribers_mutex_);
+        if (subscribers_.empty()) {
+            return;
+        }
+
+        pa_usec_t now = WallClockUsec();
+        for (auto& entry : subscribers_) {
+            Subscriber& subscriber = entry.second;
+            subscriber.changed.erase(session.handle);
+            subscriber.removed.insert(session.handle);
+            if (!subscriber.pending_since) {
+                subscriber.pending_since = now;
+            }
+        }
+    }
+    ScheduleFlush();
+}
+
+void SessionChangeNotifier::OnActivityModeChanged(ActivityMode mode) {
+    // Re-time pending deliveries for the new mode; suspended drops the timer
+    // and keeps the changes for the next resume
+    ScheduleFlush();
+}
+
+void SessionChangeNotifier::OnEngineStopping() {
+    // The timer belongs to the engine's mainloop, which Stop() frees; pending
+    // changes wait for the next flush after a restart
+    if (flush_event_) {
+        PulseEngine::Instance().GetMainloopApi()->time_free(flush_event_);
+        flush_event_ = nullptr;
+    }
+}
+
+// A subscriber's batch waits for the mode's coalescing delay after its first
+// change, and for its own interval after its previous batch
+pa_usec_t SessionChangeNotifier::DueTime(const Subscriber& subscriber, pa_usec_t mode_delay) const {
+    return std::max(subscriber.pending_since + mode_delay, subscriber.delivered_at + subscriber.min_interval);
+}
+
+void SessionChangeNotifier::ScheduleFlush() {
+    PulseEngine& engine = PulseEngine::Instance();
+    pa_mainloop_api* api = engine.GetMainloopApi();
+    ActivityMode mode = engine.GetActivityMode();
+    pa_usec_t modeDelay = mode == ActivityMode::Foreground ? kForegroundFlushDelay : kBackgroundFlushDelay;
+
+    // One timer serves every subscriber: it fires for the earliest batch due
+    pa_usec_t due = std::numeric_limits<pa_usec_t>::max();
+    if (mode != ActivityMode::Suspended) {
+        std::lock_guard<std::mutex> lock(subscribers_mutex_);
+        for (const auto& entry : subscribers_) {
+            if (entry.second.pending_since) {
+                due = std::min(due, DueTime(entry.second, modeDelay));
+            }
+        }
+    }
+
+    if (due == std::numeric_limits<pa_usec_t>::max()) {
+        if (flush_event_) {
+            api->time_free(flush_event_);
+            flush_event_ = nullptr;
+        }
+        return;
+    }
+
+    struct timeval tv;
+    pa_timeval_store(&tv, due);
+    if (flush_event_) {
+        api->time_restart(flush_event_, &tv);
+    } else {
+        flush_event_ = api->time_new(api, &tv, FlushCallback, this);
+    }
+}
+
+void SessionChangeNotifier::FlushCallback(pa_mainloop_api* api, pa_time_event* event, const struct timeval* tv, void* userdata) {
+    SessionChangeNotifier* notifier = static_cast<SessionChangeNotifier*>(userdata);
+
+    api->time_free(event);
+    notifier->flush_event_ = nullptr;
+    notifier->Flush();
+    notifier->ScheduleFlush();
+}
+
+void SessionChangeNotifier::Flush() {
+    PulseEngine& engine = PulseEngine::Instance();
+    ActivityMode mode = engine.GetActivityMode();
+    if (mode == ActivityMode::Suspended) {
+        return;
+    }
+    pa_usec_t modeDelay = mode == ActivityMode::Foreground ? kForegroundFlushDelay : kBackgroundFlushDelay;
+    pa_usec_t now = WallClockUsec();
+
+    std::lock_guard<std::mutex> lock(subscribers_mutex_);
+    for (auto& entry : subscribers_) {
+        Subscriber& subscriber = entry.second;
+        if (!subscriber.pending_since || DueTime(subscriber, modeDelay) > now) {
+            continue;
+        }
+
+        SessionChangeBatch batch;
+        batch.changed.reserve(subscriber.changed.size());
+        for (SessionHandle handle : subscriber.changed) {
+            AudioSession session;
+            if (engine.GetSession(handle, &session)) {
+                batch.changed.push_back(std::move(session));
+            }
+        }
+        batch.removed.assign(subscriber.removed.begin(), subscriber.removed.end());
+        subscriber.changed.clear();
+        subscriber.removed.clear();
+        subscriber.pending_since = 0;
+        subscriber.delivered_at = now;
+
+        batches_++;
+        subscriber.sink(std::move(batch));
+    }
+}
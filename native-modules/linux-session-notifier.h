@@ -0,0 +1,79 @@
+#pragma once
+
+#include "linux-audio-session.h"
+#include "linux-pulse-engine.h"
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+
+// Session table changes gathered since the previous delivery
+struct SessionChangeBatch {
+    std::vector<AudioSession> changed;  // New sessions and sessions whose name, volume, mute or device changed
+    std::vector<SessionHandle> removed;
+};
+
+// Fans the engine's session table out to any number of subscribers as
+// deltas. Subscribers only hold the handles that changed since their last
+// batch; the sessions themselves are read from the table when a batch is
+// built, so extra subscribers cost no server traffic and no copies.
+//
+// Batch spacing follows the activity mode (prompt in the foreground, sparse
+// in the background, held back while suspended), and each subscriber may
+// also set a minimum interval of its own. Runs on the engine thread.
+class SessionChangeNotifier : public SessionObserver, public ActivityListener {
+public:
+    typedef std::function<void(SessionChangeBatch&&)> Sink;
+    typedef uint32_t SubscriptionId;
+
+    static SessionChangeNotifier& Instance();
+
+    // Add a subscriber (any thread); its first batch holds the whole table.
+    // The sink is called on the engine thread and must not block.
+    SubscriptionId Subscribe(Sink sink, uint32_t min_interval_ms = 0);
+
+    // Once these return the sink is never called again
+    bool Unsubscribe(SubscriptionId id);
+    void UnsubscribeAll();
+
+    bool SetMinInterval(SubscriptionId id, uint32_t min_interval_ms);
+
+    size_t GetSubscriberCount();
+    uint64_t GetBatchCount() const { return batches_; }
+
+    void OnSessionUpdated(const AudioSession& session, const AudioSession* previous) override;
+    void OnSessionRemoved(const AudioSession& session) override;
+    void OnActivityModeChanged(ActivityMode mode) override;
+    void OnEngineStopping() override;
+
+private:
+    struct Subscriber {
+        Sink sink;
+        pa_usec_t min_interval = 0;
+
+        // Engine thread: handles touched since the last batch
+        std::set<SessionHandle> changed;
+        std::set<SessionHandle> removed;
+        pa_usec_t pending_since = 0;  // First undelivered change, 0 when nothing is pending
+        pa_usec_t delivered_at = 0;
+    };
+
+    SessionChangeNotifier() = default;
+
+    pa_usec_t DueTime(const Subscriber& subscriber, pa_usec_t mode_delay) const;
+    void ScheduleFlush();
+    void Flush();
+    static void FlushCallback(pa_mainloop_api* api, pa_time_event* event, const struct timeval* tv, void* userdata);
+
+    // Guards the subscriber list; held while sinks run
+    std::mutex subscribers_mutex_;
+    std::map<SubscriptionId, Subscriber> subscribers_;
+    SubscriptionId next_id_ = 1;
+
+    // Engine thread only
+    pa_time_event* flush_event_ = nullptr;
+
+    std::atomic<uint64_t> batches_{0};
+};
@@ -0,0 +1,112 @@
+#include "linux-session-operations.h"
+
+PulseEngine::Request VolumeRequest(SessionHandle handle, const pa_cvolume& volume) {
+    return [handle, volume](pa_context* context, PulseEngine::Completion done) {
+        void* completion = PulseEngine::WrapCompletion(std::move(done));
+        uint32_t index = GetHandleIndex(handle);
+        pa_operation* op = nullptr;
+
+        switch (GetHandleKind(handle)) {
+            case SessionKind::Sink:
+                op = pa_context_set_sink_volume_by_index(context, index, &volume, PulseEngine::SuccessCompletion, completion);
+                break;
+            case SessionKind::SinkInput:
+                op = pa_context_set_sink_input_volume(context, index, &volume, PulseEngine::SuccessCompletion, completion);
+                break;
+            case SessionKind::Source:
+                op = pa_context_set_source_volume_by_index(context, index, &volume, PulseEngine::SuccessCompletion, completion);
+                break;
+            case SessionKind::SourceOutput:
+                op = pa_context_set_source_output_volume(context, index, &volume, PulseEngine::SuccessCompletion, completion);
+                break;
+            default:
+                break;
+        }
+
+        PulseEngine::FinishIssue(op, completion);
+    };
+}
+
+pa_cvolume ScaledVolume(const AudioSession& session, float percent) {
+    pa_cvolume cvolume = session.cvolume;
+
+    // A silent stream has no balance left to keep
+    if (cvolume.channels > 0 && pa_cvolume_max(&cvolume) > PA_VOLUME_MUTED) {
+        pa_cvolume_scale(&cvolume, FromPercentVolume(percent));
+        return cvolume;
+    }
+
+    uint8_t channels = cvolume.channels;
+    if (channels == 0) {
+        channels = pa_channels_valid(session.sample_spec.channels) ? session.sample_spec.channels : 2;
+    }
+    pa_cvolume_set(&cvolume, channels, FromPercentVolume(percent));
+    return cvolume;
+}
+
+bool BalancedVolume(const AudioSession& session, const float* balance, const float* fade, pa_cvolume* volume) {
+    if (session.cvolume.channels == 0) {
+        return false;
+    }
+    if ((balance && !pa_channel_map_can_balance(&session.channel_map)) ||
+        (fade && !pa_channel_map_can_fade(&session.channel_map))) {
+        return false;
+    }
+
+    *volume = session.cvolume;
+    if (balance) {
+        pa_cvolume_set_balance(volume, &session.channel_map, *balance);
+    }
+    if (fade) {
+        pa_cvolume_set_fade(volume, &session.channel_map, *fade);
+    }
+    return true;
+}
+
+PulseEngine::Request MuteRequest(SessionHandle handle, bool muted) {
+    return [handle, muted](pa_context* context, PulseEngine::Completion done) {
+        void* completion = PulseEngine::WrapCompletion(std::move(done));
+        uint32_t index = GetHandleIndex(handle);
+        int mute = muted ? 1 : 0;
+        pa_operation* op = nullptr;
+
+        switch (GetHandleKind(handle)) {
+            case SessionKind::Sink:
+                op = pa_context_set_sink_mute_by_index(context, index, mute, PulseEngine::SuccessCompletion, completion);
+                break;
+            case SessionKind::SinkInput:
+                op = pa_context_set_sink_input_mute(context, index, mute, PulseEngine::SuccessCompletion, completion);
+                break;
+            case SessionKind::Source:
+                op = pa_context_set_source_mute_by_index(context, index, mute, PulseEngine::SuccessCompletion, completion);
+                break;
+            case SessionKind::SourceOutput:
+                op = pa_context_set_source_output_mute(context, index, mute, PulseEngine::SuccessCompletion, completion);
+                break;
+            default:
+                break;
+        }
+
+        PulseEngine::FinishIssue(op, completion);
+    };
+}
+
+PulseEngine::Request MoveRequest(SessionHandle stream, SessionHandle device) {
+    return [stream, device](pa_context* context, PulseEngine::Completion done) {
+        void* completion = PulseEngine::WrapCompletion(std::move(done));
+        uint32_t index = GetHandleIndex(stream);
+        uint32_t deviceIndex = GetHandleIndex(device);
+        pa_operation* op = nullptr;
+
+        // The device must be of the kind the stream attaches to
+        if (DeviceKindFor(GetHandleKind(stream)) == GetHandleKind(device)) {
+            if (GetHandleKind(stream) == SessionKind::SinkInput) {
+                op = pa_context_move_sink_input_by_index(context, index, deviceIndex, PulseEngine::SuccessCompletion, completion);
+            } else {
+                op = pa_context_move_source_output_by_index(context, index, deviceIndex, PulseEngine::SuccessCompletion, completion);
+            }
+        }
+
+        PulseEngine::FinishIssue(op, completion);
+    };
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "linux-audio-session.h"
+#include "linux-pulse-engine.h"
+
+// Requests for the engine's operation path. Each issues one server call for
+// the session's kind and completes with the server's acknowledgement, so any
+// mix of them can be sent as one PulseEngine::RunBatch. Requests for a kind
+// the call does not apply to complete with failure at once.
+
+PulseEngine::Request VolumeRequest(SessionHandle handle, const pa_cvolume& volume);
+
+// Volume for a session at a 0-100+ percentage (its loudest channel). The
+// balance between channels is kept when the table knows it.
+pa_cvolume ScaledVolume(const AudioSession& session, float percent);
+
+// The session's current volume with balance (-1 left to 1 right) and/or
+// fade (-1 rear to 1 front) applied; null leaves that axis alone. Returns
+// false if the session's channel map cannot express the change.
+bool BalancedVolume(const AudioSession& session, const float* balance, const float* fade, pa_cvolume* volume);
+PulseEngine::Request MuteRequest(SessionHandle handle, bool muted);
+
+// Move a sink input to a sink, or a source output to a source
+PulseEngine::Request MoveRequest(SessionHandle stream, SessionHandle device);
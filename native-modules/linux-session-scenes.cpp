@@ -0,0 +1,173 @@
+#include "linux-session-scenes.h"
+#include "linux-mute-rules.h"
+#include "linux-pulse-engine.h"
+#include "linux-session-operations.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <set>
+#include <utility>
+
+const char kSceneMagic[4] = { 'A', 'M', 'P', 'S' };
+
+// Volumes closer than this are equal; the encoding keeps hundredths
+const float kSceneVolumeTolerance = 0.01f;
+
+typedef std::pair<SessionKind, std::string> SceneKey;
+
+std::vector<SceneEntry> CaptureScene(const std::vector<AudioSession>& sessions) {
+    std::vector<SceneEntry> entries;
+    std::set<SceneKey> seen;
+
+    for (const AudioSession& session : sessions) {
+        SessionKind kind = GetHandleKind(session.handle);
+        if (!seen.insert(SceneKey(kind, session.name)).second) {
+            continue;
+        }
+
+        SceneEntry entry;
+        entry.kind = kind;
+        entry.name = session.name;
+        entry.volume = session.volume;
+        entry.muted = session.muted;
+        entries.push_back(std::move(entry));
+    }
+
+    return entries;
+}
+
+static void PutVarint(std::string* out, uint64_t value) {
+    while (value >= 0x80) {
+        out->push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out->push_back(static_cast<char>(value));
+}
+
+static bool GetVarint(const uint8_t* data, size_t size, size_t* pos, uint64_t* value) {
+    *value = 0;
+    for (unsigned shift = 0; shift < 64 && *pos < size; shift += 7) {
+        uint8_t byte = data[(*pos)++];
+        *value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string EncodeScene(const std::vector<SceneEntry>& entries) {
+    std::string out(kSceneMagic, sizeof(kSceneMagic));
+    out.push_back(static_cast<char>(kSceneVersion));
+    PutVarint(&out, entries.size());
+
+    for (const SceneEntry& entry : entries) {
+        uint16_t volume = static_cast<uint16_t>(std::min(65535.0f, std::max(0.0f, std::round(entry.volume * 100.0f))));
+        out.push_back(static_cast<char>(entry.kind));
+        out.push_back(static_cast<char>(entry.muted ? 1 : 0));
+        out.push_back(static_cast<char>(volume & 0xFF));
+        out.push_back(static_cast<char>(volume >> 8));
+        PutVarint(&out, entry.name.size());
+        out.append(entry.name);
+    }
+
+    return out;
+}
+
+bool DecodeScene(const uint8_t* data, size_t size, std::vector<SceneEntry>* entries) {
+    if (size < sizeof(kSceneMagic) + 1 || std::memcmp(data, kSceneMagic, sizeof(kSceneMagic)) != 0 ||
+        data[sizeof(kSceneMagic)] != kSceneVersion) {
+        return false;
+    }
+
+    size_t pos = sizeof(kSceneMagic) + 1;
+    uint64_t count;
+    if (!GetVarint(data, size, &pos, &count) || count > size) {
+        return false;
+    }
+
+    entries->clear();
+    entries->reserve(count);
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t length;
+        if (size - pos < 4) {
+            return false;
+        }
+        SceneEntry entry;
+        entry.kind = static_cast<SessionKind>(data[pos]);
+        entry.muted = (data[pos + 1] & 1) != 0;
+        entry.volume = (data[pos + 2] | (data[pos + 3] << 8)) / 100.0f;
+        pos += 4;
+
+        if (!GetVarint(data, size, &pos, &length) || length > size - pos ||
+            !IsValidSessionHandle(MakeSessionHandle(entry.kind, 0))) {
+            return false;
+        }
+        entry.name.assign(reinterpret_cast<const char*>(data + pos), length);
+        pos += length;
+        entries->push_back(std::move(entry));
+    }
+
+    return pos == size;
+}
+
+bool ApplyScene(const std::vector<SceneEntry>& entries, SceneApplyResult* result) {
+    auto start = std::chrono::steady_clock::now();
+    PulseEngine& engine = PulseEngine::Instance();
+    if (!engine.Start()) {
+        return false;
+    }
+
+    std::map<SceneKey, const SceneEntry*> scene;
+    for (const SceneEntry& entry : entries) {
+        scene.emplace(SceneKey(entry.kind, entry.name), &entry);
+    }
+
+    // Mute first and unmute last, so nothing is briefly loud while the
+    // volumes in between land
+    std::vector<PulseEngine::Request> mutes;
+    std::vector<PulseEngine::Request> volumes;
+    std::vector<PulseEngine::Request> unmutes;
+    SceneApplyResult outcome;
+
+    for (const AudioSession& session : engine.GetSessions()) {
+        SessionKind kind = GetHandleKind(session.handle);
+        auto match = scene.find(SceneKey(kind, session.name));
+        if (match == scene.end()) {
+            continue;
+        }
+        const SceneEntry& entry = *match->second;
+        outcome.matched++;
+
+        if (std::fabs(session.volume - entry.volume) >= kSceneVolumeTolerance) {
+            volumes.push_back(VolumeRequest(session.handle, ScaledVolume(session, entry.volume)));
+        }
+        if (session.muted != entry.muted) {
+            (entry.muted ? mutes : unmutes).push_back(MuteRequest(session.handle, entry.muted));
+            if (MuteRuleEnforcer::AppliesTo(kind)) {
+                outcome.mute_rules[entry.name] = entry.muted;
+            }
+        }
+    }
+
+    // Saved states follow the scene; otherwise the rule enforcer would undo it
+    for (const auto& rule : outcome.mute_rules) {
+        MuteRuleEnforcer::Instance().SetRule(rule.first, rule.second);
+    }
+
+    std::vector<PulseEngine::Request> requests = std::move(mutes);
+    requests.insert(requests.end(), std::make_move_iterator(volumes.begin()), std::make_move_iterator(volumes.end()));
+    requests.insert(requests.end(), std::make_move_iterator(unmutes.begin()), std::make_move_iterator(unmutes.end()));
+    outcome.changed = requests.size();
+    if (!requests.empty()) {
+        outcome.applied = engine.RunBatch(std::move(requests));
+    }
+
+    outcome.elapsed_usec = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    if (result) {
+        *result = std::move(outcome);
+    }
+    return true;
+}
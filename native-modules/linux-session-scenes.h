@@ -0,0 +1,43 @@
+#pragma once
+
+#include "linux-audio-session.h"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Scenes: the volume and mute state of every session, keyed by what
+// identifies a session across restarts (its kind and name) rather than by
+// handle. Restoring a scene touches only what differs from the live table.
+//
+// Encoded form: "AMPS", a version byte, a varint entry count, then per
+// entry a kind byte, a flags byte (bit 0: muted), the volume in hundredths
+// of a percent (uint16, little-endian), a varint name length and the name.
+
+const uint8_t kSceneVersion = 1;
+
+struct SceneEntry {
+    SessionKind kind = SessionKind::Invalid;
+    std::string name;     // Application name (streams) or description (devices)
+    float volume = 0.0f;  // Percent, may exceed 100 for devices
+    bool muted = false;
+};
+
+struct SceneApplyResult {
+    size_t matched = 0;   // Live sessions the scene has an entry for
+    size_t changed = 0;   // Requests the diff needed
+    size_t applied = 0;   // Requests the server accepted
+    std::map<std::string, bool> mute_rules;  // Playback mute states set, by session name
+    uint64_t elapsed_usec = 0;                // Diff and burst, from the call to the last acknowledgement
+};
+
+// One entry per identity; the first session of an application speaks for
+// its other streams
+std::vector<SceneEntry> CaptureScene(const std::vector<AudioSession>& sessions);
+
+std::string EncodeScene(const std::vector<SceneEntry>& entries);
+bool DecodeScene(const uint8_t* data, size_t size, std::vector<SceneEntry>* entries);
+
+// Diff the scene against the engine's table and send the difference as one
+// pipelined batch. Returns false if the engine is not connected.
+bool ApplyScene(const std::vector<SceneEntry>& entries, SceneApplyResult* result);
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstring>
+
+// Four-wide float vector using GCC/Clang vector extensions. Arithmetic on it
+// compiles to SSE on x86 and NEON on ARM without per-architecture intrinsics.
+typedef float Float4 __attribute__((vector_size(16)));
+
+inline Float4 BroadcastFloat4(float value) {
+    Float4 result = { value, value, value, value };
+    return result;
+}
+
+// Unaligned load and store; memcpy lets the compiler pick the right instruction
+inline Float4 LoadFloat4(const float* source) {
+    Float4 result;
+    std::memcpy(&result, source, sizeof(result));
+    return result;
+}
+
+inline void StoreFloat4(float* target, Float4 value) {
+    std::memcpy(target, &value, sizeof(value));
+}
@@ -0,0 +1,464 @@
+#include "linux-spectrum-analyzer.h"
+#include "linux-session-history.h"
+#include "linux-stream-loop.h"
+#include <pulse/timeval.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+// Magnitudes below this map to the floor instead of -inf
+const float kMinMagnitude = 1e-6f;
+
+struct SpectrumAnalyzer::Analyzer {
+    explicit Analyzer(const SpectrumOptions& opts) : options(opts), fft(opts.fft_size) {}
+
+    SessionHandle handle = kInvalidSessionHandle;
+    SpectrumOptions options;
+    uint32_t device_index = PA_INVALID_INDEX;  // Sink the stream was on when last connected (engine thread)
+
+    // Stream loop lock
+    RealFft fft;
+    std::vector<float> output;      // Frame being written, published when complete
+    pa_stream* stream = nullptr;
+    pa_time_event* timer = nullptr;
+    struct timeval next_frame;
+    bool paused = false;
+    std::atomic<bool> ended{false};  // Stream lost while the session lives on (read on the engine thread)
+    bool retired = false;            // Released by Stop or session removal; queued tasks skip it
+    bool floor_written = false;
+
+    std::vector<float> ring;        // Latest fft_size samples
+    size_t write_pos = 0;
+    size_t new_samples = 0;         // Samples since the previous frame
+    float peak = 0.0f;
+    std::vector<float> frame;
+    std::vector<float> magnitudes;
+    std::vector<std::pair<uint32_t, uint32_t>> bands;  // FFT bin range [first, last] per output bin
+
+    uint64_t frames = 0;
+    uint64_t idle_frames = 0;
+    uint64_t cpu_nsec = 0;
+
+    // Last complete frame, copied out by Read on the JS thread
+    mutable std::mutex frame_mutex;
+    std::vector<float> published;
+    uint64_t sequence = 0;
+};
+
+SpectrumAnalyzer& SpectrumAnalyzer::Instance() {
+    static SpectrumAnalyzer analyzer;
+    return analyzer;
+}
+
+bool SpectrumAnalyzer::Start(SessionHandle handle, const SpectrumOptions& options) {
+    if (GetHandleKind(handle) != SessionKind::SinkInput || !RealFft::IsValidSize(options.fft_size) ||
+        options.bins == 0 || options.frame_rate == 0 || options.sample_rate == 0 ||
+        !(options.min_frequency > 0.0) || options.min_frequency >= options.sample_rate / 2.0) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(analyzers_mutex_);
+        if (analyzers_.count(handle)) {
+            return false;
+        }
+    }
+    if (!AudioStreamLoop::Instance().Start()) {
+        return false;
+    }
+
+    std::shared_ptr<Analyzer> analyzer = std::make_shared<Analyzer>(options);
+    analyzer->handle = handle;
+    analyzer->output.assign(options.bins, kSpectrumFloorDb);
+    analyzer->published.assign(options.bins, kSpectrumFloorDb);
+    analyzer->ring.assign(options.fft_size, 0.0f);
+    analyzer->frame.resize(options.fft_size);
+    analyzer->magnitudes.resize(options.fft_size / 2 + 1);
+    analyzer->paused = PulseEngine::Instance().GetActivityMode() != ActivityMode::Foreground;
+
+    AudioSession session;
+    if (PulseEngine::Instance().GetSession(handle, &session)) {
+        analyzer->device_index = session.device_index;
+    }
+
+    // Geometric band edges from min_frequency to Nyquist; bands narrower than
+    // one FFT bin take the bin nearest their centre
+    double binHz = static_cast<double>(options.sample_rate) / options.fft_size;
+    double ratio = std::pow(options.sample_rate / 2.0 / options.min_frequency, 1.0 / options.bins);
+    uint32_t lastBin = options.fft_size / 2;
+    for (uint32_t b = 0; b < options.bins; b++) {
+        double low = options.min_frequency * std::pow(ratio, b);
+        double high = low * ratio;
+        double first = std::ceil(low / binHz);
+        double last = std::floor(high / binHz);
+        if (last < first) {
+            first = last = std::round(std::sqrt(low * high) / binHz);
+        }
+        analyzer->bands.emplace_back(std::min<uint32_t>(std::max(first, 1.0), lastBin),
+                                     std::min<uint32_t>(std::max(last, 1.0), lastBin));
+    }
+
+    Analyzer* raw = analyzer.get();
+    {
+        AudioStreamLoop::Lock lock;
+        FillFloor(raw);
+        if (!Connect(raw) || !AudioStreamLoop::Instance().WaitForStream(raw->stream)) {
+            Disconnect(raw);
+            return false;
+        }
+        if (!raw->paused) {
+            ScheduleFrame(raw);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(analyzers_mutex_);
+    analyzers_[handle] = std::move(analyzer);
+    return true;
+}
+
+bool SpectrumAnalyzer::Stop(SessionHandle handle) {
+    std::shared_ptr<Analyzer> analyzer;
+    {
+        std::lock_guard<std::mutex> lock(analyzers_mutex_);
+        auto it = analyzers_.find(handle);
+        if (it == analyzers_.end()) {
+            return false;
+        }
+        analyzer = std::move(it->second);
+        analyzers_.erase(it);
+    }
+
+    AudioStreamLoop::Lock lock;
+    Retire(analyzer.get());
+    return true;
+}
+
+bool SpectrumAnalyzer::IsRunning(SessionHandle handle) const {
+    std::lock_guard<std::mutex> lock(analyzers_mutex_);
+    return analyzers_.count(handle) > 0;
+}
+
+void SpectrumAnalyzer::Retire(Analyzer* analyzer) {
+    if (analyzer->retired) {
+        return;
+    }
+    analyzer->retired = true;
+    Disconnect(analyzer);
+    if (analyzer->timer) {
+        AudioStreamLoop::Instance().GetMainloopApi()->time_free(analyzer->timer);
+        analyzer->timer = nullptr;
+    }
+}
+
+void SpectrumAnalyzer::StopAll() {
+    std::vector<SessionHandle> handles;
+    {
+        std::lock_guard<std::mutex> lock(analyzers_mutex_);
+        for (const auto& entry : analyzers_) {
+            handles.push_back(entry.first);
+        }
+    }
+    for (SessionHandle handle : handles) {
+        Stop(handle);
+    }
+}
+
+bool SpectrumAnalyzer::Connect(Analyzer* analyzer) {
+    pa_sample_spec spec;
+    spec.format = PA_SAMPLE_FLOAT32NE;
+    spec.rate = analyzer->options.sample_rate;
+    spec.channels = 1;
+
+    analyzer->stream = AudioStreamLoop::Instance().CreateStream("AmpCore Spectrum", "spectrum", spec);
+    if (!analyzer->stream) {
+        return false;
+    }
+
+    // One fragment per frame keeps wakeups at the frame rate
+    pa_buffer_attr attr;
+    attr.maxlength = static_cast<uint32_t>(-1);
+    attr.tlength = static_cast<uint32_t>(-1);
+    attr.prebuf = static_cast<uint32_t>(-1);
+    attr.minreq = static_cast<uint32_t>(-1);
+    attr.fragsize = static_cast<uint32_t>(pa_usec_to_bytes(PA_USEC_PER_SEC / analyzer->options.frame_rate, &spec));
+
+    int flags = PA_STREAM_ADJUST_LATENCY | PA_STREAM_DONT_MOVE;
+    if (analyzer->paused) {
+        flags |= PA_STREAM_START_CORKED;
+    }
+
+    // With a monitored sink input the server picks its sink's monitor itself
+    pa_stream_set_monitor_stream(analyzer->stream, GetHandleIndex(analyzer->handle));
+    pa_stream_set_read_callback(analyzer->stream, ReadCallback, analyzer);
+    return pa_stream_connect_record(analyzer->stream, nullptr, &attr, static_cast<pa_stream_flags_t>(flags)) == 0;
+}
+
+void SpectrumAnalyzer::Disconnect(Analyzer* analyzer) {
+    AudioStreamLoop::ReleaseStream(analyzer->stream);
+    analyzer->stream = nullptr;
+}
+
+void SpectrumAnalyzer::SetPaused(Analyzer* analyzer, bool paused) {
+    if (analyzer->paused == paused) {
+        return;
+    }
+    analyzer->paused = paused;
+
+    if (analyzer->stream && pa_stream_get_state(analyzer->stream) == PA_STREAM_READY) {
+        pa_operation* op = pa_stream_cork(analyzer->stream, paused ? 1 : 0, nullptr, nullptr);
+        if (op) {
+            pa_operation_unref(op);
+        }
+    }
+
+    if (paused) {
+        if (analyzer->timer) {
+            AudioStreamLoop::Instance().GetMainloopApi()->time_restart(analyzer->timer, nullptr);
+        }
+    } else if (!analyzer->ended) {
+        ScheduleFrame(analyzer);
+    }
+}
+
+void SpectrumAnalyzer::ScheduleFrame(Analyzer* analyzer) {
+    pa_mainloop_api* api = AudioStreamLoop::Instance().GetMainloopApi();
+    pa_timeval_add(pa_gettimeofday(&analyzer->next_frame), PA_USEC_PER_SEC / analyzer->options.frame_rate);
+
+    if (analyzer->timer) {
+        api->time_restart(analyzer->timer, &analyzer->next_frame);
+    } else {
+        analyzer->timer = api->time_new(api, &analyzer->next_frame, FrameCallback, analyzer);
+    }
+}
+
+void SpectrumAnalyzer::FrameCallback(pa_mainloop_api* api, pa_time_event* event, const struct timeval* tv, void* userdata) {
+    Analyzer* analyzer = static_cast<Analyzer*>(userdata);
+    ComputeFrame(analyzer);
+
+    // Step from the previous deadline so the rate does not drift; start over
+    // if the loop fell behind by more than a frame
+    struct timeval now;
+    pa_gettimeofday(&now);
+    pa_timeval_add(&analyzer->next_frame, PA_USEC_PER_SEC / analyzer->options.frame_rate);
+    if (pa_timeval_cmp(&analyzer->next_frame, &now) < 0) {
+        ScheduleFrame(analyzer);
+        return;
+    }
+    api->time_restart(event, &analyzer->next_frame);
+}
+
+void SpectrumAnalyzer::ReadCallback(pa_stream* stream, size_t nbytes, void* userdata) {
+    Analyzer* analyzer = static_cast<Analyzer*>(userdata);
+    size_t size = analyzer->ring.size();
+
+    const void* data;
+    size_t length;
+    while (pa_stream_peek(stream, &data, &length) == 0 && length > 0) {
+        if (data) {
+            const float* samples = static_cast<const float*>(data);
+            size_t count = length / sizeof(float);
+            for (size_t i = 0; i < count; i++) {
+                analyzer->ring[analyzer->write_pos] = samples[i];
+                analyzer->write_pos = (analyzer->write_pos + 1) % size;
+                analyzer->peak = std::max(analyzer->peak, std::fabs(samples[i]));
+            }
+            analyzer->new_samples += count;
+        }
+        pa_stream_drop(stream);
+    }
+}
+
+void SpectrumAnalyzer::ComputeFrame(Analyzer* analyzer) {
+    // Nothing new since the last frame: the displayed spectrum still holds
+    if (analyzer->new_samples == 0) {
+        analyzer->idle_frames++;
+        return;
+    }
+
+    uint64_t started = AudioStreamLoop::ThreadCpuNsec();
+    size_t size = analyzer->ring.size();
+
+    // Oldest sample first
+    size_t tail = size - analyzer->write_pos;
+    std::copy(analyzer->ring.begin() + analyzer->write_pos, analyzer->ring.end(), analyzer->frame.begin());
+    std::copy(analyzer->ring.begin(), analyzer->ring.begin() + analyzer->write_pos, analyzer->frame.begin() + tail);
+
+    analyzer->fft.Transform(analyzer->frame.data(), analyzer->magnitudes.data());
+
+    for (size_t b = 0; b < analyzer->bands.size(); b++) {
+        const auto& band = analyzer->bands[b];
+        float magnitude = kMinMagnitude;
+        for (uint32_t k = band.first; k <= band.second; k++) {
+            magnitude = std::max(magnitude, analyzer->magnitudes[k]);
+        }
+        analyzer->output[b] = std::max(kSpectrumFloorDb, 20.0f * std::log10(magnitude));
+    }
+    analyzer->floor_written = false;
+    Publish(analyzer);
+
+    SessionHistory::Instance().RecordPeak(analyzer->handle, std::min(analyzer->peak, 1.0f));
+    analyzer->peak = 0.0f;
+    analyzer->new_samples = 0;
+    analyzer->frames++;
+    analyzer->cpu_nsec += AudioStreamLoop::ThreadCpuNsec() - started;
+}
+
+void SpectrumAnalyzer::FillFloor(Analyzer* analyzer) {
+    if (analyzer->floor_written) {
+        return;
+    }
+    std::fill(analyzer->output.begin(), analyzer->output.end(), kSpectrumFloorDb);
+    analyzer->floor_written = true;
+    Publish(analyzer);
+}
+
+void SpectrumAnalyzer::Publish(Analyzer* analyzer) {
+    std::lock_guard<std::mutex> lock(analyzer->frame_mutex);
+    analyzer->published = analyzer->output;
+    analyzer->sequence++;
+}
+
+bool SpectrumAnalyzer::Read(SessionHandle handle, float* output, uint64_t* sequence) const {
+    std::shared_ptr<Analyzer> analyzer;
+    {
+        std::lock_guard<std::mutex> lock(analyzers_mutex_);
+        auto it = analyzers_.find(handle);
+        if (it == analyzers_.end()) {
+            return false;
+        }
+        analyzer = it->second;
+    }
+
+    std::lock_guard<std::mutex> frameLock(analyzer->frame_mutex);
+    std::copy(analyzer->published.begin(), analyzer->published.end(), output);
+    *sequence = analyzer->sequence;
+    return true;
+}
+
+void SpectrumAnalyzer::End(Analyzer* analyzer) {
+    analyzer->ended = true;
+    Disconnect(analyzer);
+    if (analyzer->timer) {
+        AudioStreamLoop::Instance().GetMainloopApi()->time_restart(analyzer->timer, nullptr);
+    }
+    FillFloor(analyzer);
+}
+
+void SpectrumAnalyzer::Reconnect(Analyzer* analyzer) {
+    Disconnect(analyzer);
+    if (!Connect(analyzer)) {
+        // Silent until the session updates again
+        End(analyzer);
+        return;
+    }
+    analyzer->ended = false;
+    if (!analyzer->paused) {
+        ScheduleFrame(analyzer);
+    }
+}
+
+// The observer callbacks below run on the engine thread, which must not wait
+// for the stream loop (Start may hold it while a stream connects), so stream
+// work is posted to the loop with a reference that outlives Stop
+
+void SpectrumAnalyzer::OnSessionUpdated(const AudioSession& session, const AudioSession* previous) {
+    std::shared_ptr<Analyzer> analyzer;
+    {
+        std::lock_guard<std::mutex> lock(analyzers_mutex_);
+        auto it = analyzers_.find(session.handle);
+        if (it == analyzers_.end()) {
+            return;
+        }
+        analyzer = it->second;
+    }
+
+    // Moving a sink input ends its monitor streams; follow it to the new sink
+    bool moved = false;
+    if (analyzer->device_index != session.device_index) {
+        moved = analyzer->device_index != PA_INVALID_INDEX;
+        analyzer->device_index = session.device_index;
+    }
+
+    // An analyzer whose stream could not reconnect tries again on each update
+    if (!moved && !analyzer->ended) {
+        return;
+    }
+    AudioStreamLoop::Instance().Post([analyzer, moved] {
+        if (analyzer->retired || (!moved && !analyzer->ended)) {
+            return;
+        }
+        Reconnect(analyzer.get());
+    });
+}
+
+void SpectrumAnalyzer::OnSessionRemoved(const AudioSession& session) {
+    std::shared_ptr<Analyzer> analyzer;
+    {
+        std::lock_guard<std::mutex> lock(analyzers_mutex_);
+        auto it = analyzers_.find(session.handle);
+        if (it == analyzers_.end()) {
+            return;
+        }
+        analyzer = std::move(it->second);
+        analyzers_.erase(it);
+    }
+
+    // A later stream reusing the handle gets a fresh analyzer
+    AudioStreamLoop::Instance().Post([analyzer] {
+        Retire(analyzer.get());
+    });
+}
+
+void SpectrumAnalyzer::OnActivityModeChanged(ActivityMode mode) {
+    std::vector<std::shared_ptr<Analyzer>> analyzers;
+    {
+        std::lock_guard<std::mutex> lock(analyzers_mutex_);
+        for (const auto& entry : analyzers_) {
+            analyzers.push_back(entry.second);
+        }
+    }
+    if (analyzers.empty()) {
+        return;
+    }
+
+    bool paused = mode != ActivityMode::Foreground;
+    AudioStreamLoop::Instance().Post([analyzers, paused] {
+        for (const auto& analyzer : analyzers) {
+            if (!analyzer->retired) {
+                SetPaused(analyzer.get(), paused);
+            }
+        }
+    });
+}
+
+std::vector<SpectrumStats> SpectrumAnalyzer::GetStats() const {
+    std::vector<std::shared_ptr<Analyzer>> analyzers;
+    {
+        std::lock_guard<std::mutex> lock(analyzers_mutex_);
+        for (const auto& entry : analyzers_) {
+            analyzers.push_back(entry.second);
+        }
+    }
+
+    std::vector<SpectrumStats> stats;
+    if (analyzers.empty()) {
+        return stats;
+    }
+
+    AudioStreamLoop::Lock loopLock;
+    for (const auto& entry : analyzers) {
+        const Analyzer* analyzer = entry.get();
+        SpectrumStats item;
+        item.handle = analyzer->handle;
+        item.bins = analyzer->options.bins;
+        item.frame_rate = analyzer->options.frame_rate;
+        item.fft_size = analyzer->options.fft_size;
+        item.sample_rate = analyzer->options.sample_rate;
+        item.paused = analyzer->paused;
+        item.connected = analyzer->stream && pa_stream_get_state(analyzer->stream) == PA_STREAM_READY;
+        item.frames = analyzer->frames;
+        item.idle_frames = analyzer->idle_frames;
+        item.cpu_usec_per_frame = analyzer->frames ? analyzer->cpu_nsec / 1000.0 / analyzer->frames : 0.0;
+        stats.push_back(item);
+    }
+    return stats;
+}
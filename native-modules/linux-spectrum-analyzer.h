@@ -0,0 +1,91 @@
+#pragma once
+
+#include "linux-audio-session.h"
+#include "linux-fft.h"
+#include "linux-pulse-engine.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Lowest value written to a spectrum, in dBFS
+const float kSpectrumFloorDb = -120.0f;
+
+struct SpectrumOptions {
+    uint32_t bins = 64;           // Log-spaced bands from min_frequency to Nyquist
+    uint32_t frame_rate = 30;     // Frames written per second
+    uint32_t fft_size = 2048;
+    uint32_t sample_rate = 48000; // Rate the monitor stream is requested at
+    double min_frequency = 20.0;
+};
+
+struct SpectrumStats {
+    SessionHandle handle;
+    uint32_t bins;
+    uint32_t frame_rate;
+    uint32_t fft_size;
+    uint32_t sample_rate;
+    bool paused;          // Held by the activity mode
+    bool connected;       // Monitor stream is running
+    uint64_t frames;      // Frames computed
+    uint64_t idle_frames; // Frame ticks skipped because no audio arrived
+    double cpu_usec_per_frame;
+};
+
+// Live spectrum of application streams.
+//
+// Each analyzer taps one sink input through a mono monitor stream
+// (pa_stream_set_monitor_stream), so the server delivers only that
+// application's audio, already downmixed. Samples collect in a ring; a timer
+// on the stream loop computes one windowed FFT per frame and publishes the
+// log-binned magnitudes as a native frame, which Read copies out on the
+// caller's thread. Nothing runs for
+// sessions without an analyzer, frames with no new audio skip the FFT, and
+// outside the foreground the streams are corked and the timers stopped.
+// Each frame's peak also feeds the session history.
+class SpectrumAnalyzer : public SessionObserver, public ActivityListener {
+public:
+    static SpectrumAnalyzer& Instance();
+
+    // Start analyzing a sink input. Returns false if the session kind is
+    // wrong, an analyzer is already running for it, or the stream cannot connect.
+    bool Start(SessionHandle handle, const SpectrumOptions& options);
+    bool Stop(SessionHandle handle);
+    void StopAll();
+
+    // Copy the last complete frame (options.bins floats) into output and
+    // report its sequence number, which grows by one per published frame.
+    // Returns false if no analyzer runs for the session.
+    bool Read(SessionHandle handle, float* output, uint64_t* sequence) const;
+
+    // Whether an analyzer runs for the session; it ends with the session
+    bool IsRunning(SessionHandle handle) const;
+
+    std::vector<SpectrumStats> GetStats() const;
+
+    void OnSessionUpdated(const AudioSession& session, const AudioSession* previous) override;
+    void OnSessionRemoved(const AudioSession& session) override;
+    void OnActivityModeChanged(ActivityMode mode) override;
+
+private:
+    struct Analyzer;
+
+    SpectrumAnalyzer() = default;
+
+    static bool Connect(Analyzer* analyzer);
+    static void Disconnect(Analyzer* analyzer);
+    static void Reconnect(Analyzer* analyzer);
+    static void End(Analyzer* analyzer);
+    static void Retire(Analyzer* analyzer);
+    static void SetPaused(Analyzer* analyzer, bool paused);
+    static void ScheduleFrame(Analyzer* analyzer);
+    static void ComputeFrame(Analyzer* analyzer);
+    static void FillFloor(Analyzer* analyzer);
+    static void Publish(Analyzer* analyzer);
+
+    static void ReadCallback(pa_stream* stream, size_t nbytes, void* userdata);
+    static void FrameCallback(pa_mainloop_api* api, pa_time_event* event, const struct timeval* tv, void* userdata);
+
+    mutable std::mutex analyzers_mutex_;
+    std::map<SessionHandle, std::shared_ptr<Analyzer>> analyzers_;
+};
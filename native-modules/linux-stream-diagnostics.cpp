@@ -0,0 +1,50 @@
+#include "linux-stream-diagnostics.h"
+#include <map>
+
+std::vector<StreamDiagnostics> CollectStreamDiagnostics(const std::vector<AudioSession>& sessions,
+                                                        uint64_t max_latency_usec) {
+    // Device formats by handle, to tell whether a stream is converted between
+    // the application and its device
+    std::map<SessionHandle, pa_sample_spec> deviceSpecs;
+    for (const AudioSession& session : sessions) {
+        if (!IsStreamKind(GetHandleKind(session.handle))) {
+            deviceSpecs[session.handle] = session.sample_spec;
+        }
+    }
+
+    std::vector<StreamDiagnostics> report;
+    for (const AudioSession& session : sessions) {
+        SessionKind kind = GetHandleKind(session.handle);
+        if (!IsStreamKind(kind)) {
+            continue;
+        }
+
+        StreamDiagnostics diagnostics;
+        diagnostics.handle = session.handle;
+        diagnostics.name = session.name;
+        diagnostics.device = MakeSessionHandle(DeviceKindFor(kind), session.device_index);
+        diagnostics.sample_spec = session.sample_spec;
+        diagnostics.device_spec = { PA_SAMPLE_INVALID, 0, 0 };
+        diagnostics.resample_method = session.resample_method;
+        diagnostics.corked = session.corked;
+        diagnostics.buffer_usec = session.buffer_usec;
+        diagnostics.device_usec = session.device_usec;
+        diagnostics.total_usec = session.buffer_usec + session.device_usec;
+        diagnostics.resampled = false;
+        diagnostics.remapped = false;
+
+        auto device = deviceSpecs.find(diagnostics.device);
+        if (device != deviceSpecs.end()) {
+            const pa_sample_spec& stream = session.sample_spec;
+            diagnostics.device_spec = device->second;
+            diagnostics.resampled = stream.rate != device->second.rate;
+            diagnostics.remapped = !diagnostics.resampled &&
+                (stream.format != device->second.format || stream.channels != device->second.channels);
+        }
+        diagnostics.excessive_buffering = diagnostics.total_usec > max_latency_usec;
+
+        report.push_back(diagnostics);
+    }
+
+    return report;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "linux-audio-session.h"
+#include <string>
+#include <vector>
+
+// Buffering above this end-to-end latency is flagged as excessive by default
+const uint64_t kDefaultMaxStreamLatencyUsec = 200000;
+
+// Per-stream latency and resampler report derived from the session table
+struct StreamDiagnostics {
+    SessionHandle handle;
+    std::string name;
+    SessionHandle device;            // Sink the stream plays to, or source it records from
+    pa_sample_spec sample_spec;      // Stream format
+    pa_sample_spec device_spec;      // Device format (invalid if the device is unknown)
+    std::string resample_method;
+    bool corked;
+    uint64_t buffer_usec;
+    uint64_t device_usec;
+    uint64_t total_usec;
+    bool resampled;                  // Stream and device rates differ
+    bool remapped;                   // Format or channel count converted without a rate change
+    bool excessive_buffering;        // total_usec above the threshold
+};
+
+// Build diagnostics for every stream in a table snapshot. Works purely on the
+// cached records, so it costs no server round trips.
+std::vector<StreamDiagnostics> CollectStreamDiagnostics(const std::vector<AudioSession>& sessions,
+                                                        uint64_t max_latency_usec);
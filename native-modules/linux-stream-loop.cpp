@@ -0,0 +1,219 @@
+#include "linux-stream-loop.h"
+#include "linux-audio-session.h"
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+AudioStreamLoop& AudioStreamLoop::Instance() {
+    static AudioStreamLoop loop;
+    return loop;
+}
+
+AudioStreamLoop::~AudioStreamLoop() {
+    Stop();
+    if (wake_read_fd_ >= 0) {
+        close(wake_read_fd_);
+        close(wake_write_fd_.load());
+    }
+}
+
+bool AudioStreamLoop::Start() {
+    std::lock_guard<std::mutex> lock(start_mutex_);
+
+    if (!mainloop_) {
+        mainloop_ = pa_threaded_mainloop_new();
+        if (!mainloop_) {
+            return false;
+        }
+        if (pa_threaded_mainloop_start(mainloop_) < 0) {
+            pa_threaded_mainloop_free(mainloop_);
+            mainloop_ = nullptr;
+            return false;
+        }
+    }
+
+    pa_threaded_mainloop_lock(mainloop_);
+
+    if (!wake_event_) {
+        if (wake_read_fd_ < 0) {
+            int fds[2];
+            if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) == 0) {
+                wake_read_fd_ = fds[0];
+                wake_write_fd_ = fds[1];
+            }
+        }
+        if (wake_read_fd_ >= 0) {
+            pa_mainloop_api* api = pa_threaded_mainloop_get_api(mainloop_);
+            wake_event_ = api->io_new(api, wake_read_fd_, PA_IO_EVENT_INPUT, WakeCallback, this);
+            // Run anything posted while the loop was down
+            char byte = 0;
+            ssize_t written = write(wake_write_fd_.load(), &byte, 1);
+            (void)written;
+        }
+    }
+
+    // Drop a connection the server closed; streams on it are already dead
+    if (context_) {
+        pa_context_state_t state = pa_context_get_state(context_);
+        if (state == PA_CONTEXT_FAILED || state == PA_CONTEXT_TERMINATED) {
+            pa_context_set_state_callback(context_, nullptr, nullptr);
+            pa_context_unref(context_);
+            context_ = nullptr;
+        }
+    }
+
+    if (!context_) {
+        context_ = pa_context_new(pa_threaded_mainloop_get_api(mainloop_), "AmpCore Streams");
+        if (context_) {
+            pa_context_set_state_callback(context_, ContextStateCallback, this);
+            if (pa_context_connect(context_, NULL, PA_CONTEXT_NOAUTOSPAWN, NULL) < 0) {
+                pa_context_set_state_callback(context_, nullptr, nullptr);
+                pa_context_unref(context_);
+                context_ = nullptr;
+            }
+        }
+    }
+
+    // Connection attempts always end in READY, FAILED or TERMINATED
+    bool ready = false;
+    while (context_) {
+        pa_context_state_t state = pa_context_get_state(context_);
+        if (state == PA_CONTEXT_READY) {
+            ready = true;
+            break;
+        }
+        if (state == PA_CONTEXT_FAILED || state == PA_CONTEXT_TERMINATED) {
+            break;
+        }
+        pa_threaded_mainloop_wait(mainloop_);
+    }
+
+    pa_threaded_mainloop_unlock(mainloop_);
+    return ready;
+}
+
+void AudioStreamLoop::Stop() {
+    std::lock_guard<std::mutex> lock(start_mutex_);
+    if (!mainloop_) {
+        return;
+    }
+
+    pa_threaded_mainloop_lock(mainloop_);
+    if (context_) {
+        pa_context_set_state_callback(context_, nullptr, nullptr);
+        pa_context_disconnect(context_);
+        pa_context_unref(context_);
+        context_ = nullptr;
+    }
+    pa_threaded_mainloop_unlock(mainloop_);
+
+    pa_threaded_mainloop_stop(mainloop_);
+    pa_threaded_mainloop_free(mainloop_);
+    mainloop_ = nullptr;
+    wake_event_ = nullptr;
+
+    std::lock_guard<std::mutex> tasksLock(tasks_mutex_);
+    tasks_.clear();
+}
+
+void AudioStreamLoop::Post(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex_);
+        tasks_.push_back(std::move(task));
+    }
+
+    // A full pipe already has a wakeup pending
+    int fd = wake_write_fd_.load();
+    if (fd >= 0) {
+        char byte = 0;
+        ssize_t written = write(fd, &byte, 1);
+        (void)written;
+    }
+}
+
+void AudioStreamLoop::RunPostedTasks() {
+    std::vector<Task> tasks;
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex_);
+        tasks.swap(tasks_);
+    }
+
+    for (auto& task : tasks) {
+        task();
+    }
+}
+
+void AudioStreamLoop::WakeCallback(pa_mainloop_api* api, pa_io_event* event, int fd, pa_io_event_flags_t flags, void* userdata) {
+    AudioStreamLoop* loop = static_cast<AudioStreamLoop*>(userdata);
+    char buffer[64];
+    while (read(fd, buffer, sizeof(buffer)) > 0) {
+    }
+    loop->RunPostedTasks();
+}
+
+void AudioStreamLoop::LockLoop() {
+    pa_threaded_mainloop_lock(mainloop_);
+}
+
+void AudioStreamLoop::UnlockLoop() {
+    pa_threaded_mainloop_unlock(mainloop_);
+}
+
+void AudioStreamLoop::ContextStateCallback(pa_context* context, void* userdata) {
+    AudioStreamLoop* loop = static_cast<AudioStreamLoop*>(userdata);
+    pa_threaded_mainloop_signal(loop->mainloop_, 0);
+}
+
+void AudioStreamLoop::StreamStateCallback(pa_stream* stream, void* userdata) {
+    AudioStreamLoop* loop = static_cast<AudioStreamLoop*>(userdata);
+    pa_threaded_mainloop_signal(loop->mainloop_, 0);
+}
+
+pa_stream* AudioStreamLoop::CreateStream(const char* name, const char* role, const pa_sample_spec& spec) {
+    if (!context_ || pa_context_get_state(context_) != PA_CONTEXT_READY) {
+        return nullptr;
+    }
+
+    pa_proplist* proplist = pa_proplist_new();
+    pa_proplist_sets(proplist, PA_PROP_APPLICATION_NAME, "AmpCore");
+    pa_proplist_sets(proplist, kInternalStreamProperty, role);
+
+    // A null channel map picks the default layout for the channel count
+    pa_stream* stream = pa_stream_new_with_proplist(context_, name, &spec, nullptr, proplist);
+    pa_proplist_free(proplist);
+    return stream;
+}
+
+bool AudioStreamLoop::WaitForStream(pa_stream* stream) {
+    pa_stream_set_state_callback(stream, StreamStateCallback, this);
+
+    pa_stream_state_t state;
+    while ((state = pa_stream_get_state(stream)) == PA_STREAM_CREATING) {
+        pa_threaded_mainloop_wait(mainloop_);
+    }
+
+    pa_stream_set_state_callback(stream, nullptr, nullptr);
+    return state == PA_STREAM_READY;
+}
+
+void AudioStreamLoop::ReleaseStream(pa_stream* stream) {
+    if (!stream) {
+        return;
+    }
+
+    pa_stream_set_state_callback(stream, nullptr, nullptr);
+    pa_stream_set_read_callback(stream, nullptr, nullptr);
+    pa_stream_set_write_callback(stream, nullptr, nullptr);
+    pa_stream_set_underflow_callback(stream, nullptr, nullptr);
+    pa_stream_set_overflow_callback(stream, nullptr, nullptr);
+    if (pa_stream_get_state(stream) == PA_STREAM_READY) {
+        pa_stream_disconnect(stream);
+    }
+    pa_stream_unref(stream);
+}
+
+uint64_t AudioStreamLoop::ThreadCpuNsec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <pulse/pulseaudio.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// Second PulseAudio connection for the audio streams AmpCore opens itself
+// (DSP inserts, analyzers). It runs a pa_threaded_mainloop so stream callbacks
+// are served on their own thread and never queue behind table updates on the
+// engine thread. Streams created here carry kInternalStreamProperty, which
+// keeps them out of the session table.
+class AudioStreamLoop {
+public:
+    typedef std::function<void()> Task;
+
+    static AudioStreamLoop& Instance();
+
+    ~AudioStreamLoop();
+
+    // Connect if needed and wait (bounded) for the context; returns whether it
+    // is ready. Must not be called with the loop locked.
+    bool Start();
+    void Stop();
+
+    // Run a task on the stream thread with the lock held. Never waits for the
+    // lock, so it is safe from the engine thread; tasks still queued when the
+    // loop stops are dropped.
+    void Post(Task task);
+
+    // Scoped loop lock. Every stream call made outside a loop callback must
+    // hold it; callbacks already run with it held. Only valid after Start().
+    class Lock {
+    public:
+        Lock() { AudioStreamLoop::Instance().LockLoop(); }
+        ~Lock() { AudioStreamLoop::Instance().UnlockLoop(); }
+        Lock(const Lock&) = delete;
+        Lock& operator=(const Lock&) = delete;
+    };
+
+    // The following require the lock
+
+    // Mainloop API for timers on the stream thread
+    pa_mainloop_api* GetMainloopApi() const { return pa_threaded_mainloop_get_api(mainloop_); }
+
+    // Create a stream marked as internal; role names the user of the stream
+    pa_stream* CreateStream(const char* name, const char* role, const pa_sample_spec& spec);
+
+    // Wait until a freshly connected stream leaves PA_STREAM_CREATING. The
+    // stream's state callback is replaced; returns whether it became ready.
+    bool WaitForStream(pa_stream* stream);
+
+    // Disconnect and release a stream, clearing its callbacks first
+    static void ReleaseStream(pa_stream* stream);
+
+    // CPU time used by the calling thread, for per-stream cost accounting
+    static uint64_t ThreadCpuNsec();
+
+private:
+    AudioStreamLoop() = default;
+    AudioStreamLoop(const AudioStreamLoop&) = delete;
+    AudioStreamLoop& operator=(const AudioStreamLoop&) = delete;
+
+    void LockLoop();
+    void UnlockLoop();
+
+    void RunPostedTasks();
+
+    static void WakeCallback(pa_mainloop_api* api, pa_io_event* event, int fd, pa_io_event_flags_t flags, void* userdata);
+    static void ContextStateCallback(pa_context* context, void* userdata);
+    static void StreamStateCallback(pa_stream* stream, void* userdata);
+
+    std::mutex start_mutex_;
+    pa_threaded_mainloop* mainloop_ = nullptr;
+    pa_context* context_ = nullptr;
+
+    // Posted tasks; a byte on the wake pipe gets the loop to run them
+    std::mutex tasks_mutex_;
+    std::vector<Task> tasks_;
+    int wake_read_fd_ = -1;
+    std::atomic<int> wake_write_fd_{-1};
+    pa_io_event* wake_event_ = nullptr;
+};